@@ -0,0 +1,62 @@
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Allocator private API
+//
+
+void* defaultAlloc(void *userData, size_t size)
+{
+    return malloc(size);
+}
+
+void* defaultRealloc(void *userData, void *ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void defaultFree(void *userData, void *ptr)
+{
+    free(ptr);
+}
+
+static const JSONAllocator defaultAllocator = { defaultAlloc, defaultRealloc, defaultFree, NULL };
+
+const JSONAllocator* getAllocator(const JSONAllocator *allocator)
+{
+    return allocator ? allocator : &defaultAllocator;
+}
+
+void* allocMemory(const JSONAllocator *allocator, size_t size)
+{
+    allocator = getAllocator(allocator);
+
+    return allocator->alloc(allocator->userData, size);
+}
+
+void* allocZeroedMemory(const JSONAllocator *allocator, size_t size)
+{
+    void *ptr = allocMemory(allocator, size);
+    if (ptr)
+    {
+        memset(ptr, 0, size);
+    }
+
+    return ptr;
+}
+
+void* reallocMemory(const JSONAllocator *allocator, void *ptr, size_t size)
+{
+    allocator = getAllocator(allocator);
+
+    return allocator->realloc(allocator->userData, ptr, size);
+}
+
+void freeMemory(const JSONAllocator *allocator, void *ptr)
+{
+    allocator = getAllocator(allocator);
+
+    allocator->free(allocator->userData, ptr);
+}
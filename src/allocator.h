@@ -0,0 +1,13 @@
+#pragma once
+
+#include "json.h"
+
+// Every allocation of the library goes through these. A NULL allocator stands
+// for malloc, realloc and free, so zero initialized structs need no setup.
+void* allocMemory(const JSONAllocator *allocator, size_t size);
+void* allocZeroedMemory(const JSONAllocator *allocator, size_t size);
+void* reallocMemory(const JSONAllocator *allocator, void *ptr, size_t size);
+void freeMemory(const JSONAllocator *allocator, void *ptr);
+
+// Returns allocator, or the one wrapping malloc when it is NULL
+const JSONAllocator* getAllocator(const JSONAllocator *allocator);
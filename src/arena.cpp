@@ -0,0 +1,131 @@
+#include "arena.h"
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 8
+#define ARENA_MIN_CHUNK_SIZE (1 << 16)
+#define ARENA_MAX_CHUNK_SIZE (1 << 24)
+
+void initArena(Arena *arena, const JSONAllocator *allocator)
+{
+    memset(arena, 0, sizeof(Arena));
+    arena->nextChunkSize = ARENA_MIN_CHUNK_SIZE;
+    arena->allocator = allocator;
+}
+
+void freeArena(Arena *arena)
+{
+    ArenaChunk *chunk = arena->first;
+    while (chunk)
+    {
+        ArenaChunk *next = chunk->next;
+        freeMemory(arena->allocator, chunk);
+        chunk = next;
+    }
+
+    initArena(arena, arena->allocator);
+}
+
+void resetArena(Arena *arena)
+{
+    for (ArenaChunk *chunk = arena->first; chunk; chunk = chunk->next)
+    {
+        chunk->used = 0;
+    }
+
+    arena->current = arena->first;
+}
+
+ArenaChunk* newArenaChunk(Arena *arena, size_t minimumSize)
+{
+    size_t capacity = arena->nextChunkSize;
+    if (capacity < minimumSize)
+    {
+        capacity = minimumSize;
+    }
+
+    ArenaChunk *chunk = (ArenaChunk *) allocMemory(arena->allocator, sizeof(ArenaChunk) + capacity);
+    if (!chunk)
+    {
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+
+    if (arena->current)
+    {
+        arena->current->next = chunk;
+    }
+    else
+    {
+        arena->first = chunk;
+    }
+    arena->current = chunk;
+
+    // Grow geometrically so big documents only need a handful of chunks
+    if (arena->nextChunkSize < ARENA_MAX_CHUNK_SIZE)
+    {
+        arena->nextChunkSize *= 2;
+    }
+
+    return chunk;
+}
+
+void* arenaAlloc(Arena *arena, size_t size)
+{
+    size = (size + (ARENA_ALIGNMENT - 1)) & ~((size_t) ARENA_ALIGNMENT - 1);
+
+    ArenaChunk *chunk = arena->current;
+    while (!chunk || chunk->used + size > chunk->capacity)
+    {
+        // Chunks kept by resetArena are filled again before allocating more
+        if (chunk && chunk->next)
+        {
+            chunk = chunk->next;
+            arena->current = chunk;
+            continue;
+        }
+
+        chunk = newArenaChunk(arena, size);
+        if (!chunk)
+        {
+            return NULL;
+        }
+    }
+
+    char *ptr = (char *) (chunk + 1) + chunk->used;
+    chunk->used += size;
+
+    return ptr;
+}
+
+// Moves all the chunks of from to into, from is left empty. Both must use the
+// same allocator.
+void mergeArena(Arena *into, Arena *from)
+{
+    if (!from->first)
+    {
+        return;
+    }
+
+    // NOTE(vincent): the chunks are prepended, the current chunk of into and
+    // the ones after it kept by resetArena stay in the same order.
+    ArenaChunk *last = from->current;
+    while (last->next)
+    {
+        last = last->next;
+    }
+
+    last->next = into->first;
+    into->first = from->first;
+    if (!into->current)
+    {
+        into->current = from->current;
+    }
+
+    initArena(from, from->allocator);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "json.h"
+
+// A chunk is immediately followed by `capacity` bytes of storage.
+struct ArenaChunk
+{
+    ArenaChunk *next;
+    size_t capacity;
+    size_t used;
+};
+
+// Bump allocator owning every node and string of a document. Nothing is ever
+// freed individually, freeArena releases all the chunks at once and resetArena
+// empties them to be filled again by the next document.
+struct Arena
+{
+    ArenaChunk *first;
+    ArenaChunk *current;
+    size_t nextChunkSize;
+
+    const JSONAllocator *allocator;
+};
+
+void initArena(Arena *arena, const JSONAllocator *allocator);
+void freeArena(Arena *arena);
+void resetArena(Arena *arena);
+void* arenaAlloc(Arena *arena, size_t size);
+void mergeArena(Arena *into, Arena *from);
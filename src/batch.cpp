@@ -0,0 +1,273 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "json_private.h"
+#include "path.h"
+#include "thread.h"
+#include "json.h"
+
+// Documents handed to a thread at a time, enough to amortize the atomic
+// increment and keep threads from writing next to each other's results
+#define BATCH_DOCUMENTS_PER_GRAB 64
+
+//
+// JSONBatch private API
+//
+
+struct BatchDocument
+{
+    const char *input;
+    size_t inputLength;
+
+    JSONNode root;
+    JSONError error;
+};
+
+struct JSONBatch
+{
+    BatchDocument *documents;
+    size_t count;
+    size_t capacity;
+    size_t next; // see JSONBatchGetNext
+
+    // One per thread, each thread allocates in its own arena without locking
+    JSONDocument **workerDocuments;
+    uint32_t workerCount;
+
+    JSONAllocator allocator;
+};
+
+struct BatchWorker
+{
+    JSONBatch *batch;
+    JSONDocument *document;
+    uint32_t flags;
+    const Projection *projection;
+    volatile size_t *nextDocument;
+};
+
+JSONError addBatchDocument(JSONBatch *batch, const char *input, size_t inputLength)
+{
+    if (batch->count == batch->capacity)
+    {
+        size_t newCapacity = batch->capacity ? batch->capacity * 2 : 1024;
+
+        BatchDocument *documents = (BatchDocument *) reallocMemory(&batch->allocator, batch->documents, sizeof(BatchDocument) * newCapacity);
+        if (!documents)
+        {
+            return ERR_OUT_OF_MEMORY;
+        }
+
+        batch->documents = documents;
+        batch->capacity = newCapacity;
+    }
+
+    BatchDocument *document = &batch->documents[batch->count++];
+    memset(document, 0, sizeof(BatchDocument));
+    document->input = input;
+    document->inputLength = inputLength;
+
+    return ERR_NOERROR;
+}
+
+// NOTE(vincent): a raw newline is not allowed inside a string, every newline
+// of a valid input is a document boundary and memchr finds them quickly.
+JSONError findBatchDocuments(JSONBatch *batch, const char *input, size_t inputLength)
+{
+    JSONError error;
+    const char *end = input + inputLength;
+
+    for (const char *line = input; line < end;)
+    {
+        const char *newline = (const char *) memchr(line, '\n', (size_t) (end - line));
+        if (!newline)
+        {
+            newline = end;
+        }
+
+        // Blank lines are skipped, the parser expects the document first
+        while (line < newline && (*line == ' ' || *line == '\t' || *line == '\r'))
+        {
+            line++;
+        }
+
+        if (line < newline)
+        {
+            if ((error = addBatchDocument(batch, line, (size_t) (newline - line))) != ERR_NOERROR)
+            {
+                return error;
+            }
+        }
+
+        line = newline + 1;
+    }
+
+    return ERR_NOERROR;
+}
+
+void parseBatchDocuments(void *userData)
+{
+    BatchWorker *worker = (BatchWorker *) userData;
+    JSONBatch *batch = worker->batch;
+    ParseScratch scratch;
+    initParseScratch(&scratch, &batch->allocator);
+
+    for (;;)
+    {
+        size_t first = atomicFetchAdd(worker->nextDocument, BATCH_DOCUMENTS_PER_GRAB);
+        if (first >= batch->count)
+        {
+            break;
+        }
+
+        size_t last = first + BATCH_DOCUMENTS_PER_GRAB;
+        if (last > batch->count)
+        {
+            last = batch->count;
+        }
+
+        for (size_t i = first; i < last; i++)
+        {
+            BatchDocument *document = &batch->documents[i];
+
+            document->error = parseDocumentRoot(worker->document, &scratch, document->input,
+                                                document->inputLength, worker->flags, worker->projection,
+                                                &document->root);
+        }
+    }
+
+    freeParseScratch(&scratch);
+}
+
+//
+// JSONBatch public API
+//
+
+JSON_API JSONBatch* JSONParseMany(const char *input, size_t inputLength, const JSONParseOptions *options,
+                                  uint32_t threadCount)
+{
+    const JSONAllocator *allocator = getAllocator(options ? options->allocator : NULL);
+
+    Projection projection = {};
+    if (options && initProjection(&projection, options->projection, options->projectionCount) != ERR_NOERROR)
+    {
+        return NULL;
+    }
+
+    JSONBatch *batch = (JSONBatch *) allocZeroedMemory(allocator, sizeof(JSONBatch));
+    if (!batch)
+    {
+        return NULL;
+    }
+    batch->allocator = *allocator;
+
+    if (findBatchDocuments(batch, input, inputLength) != ERR_NOERROR)
+    {
+        JSONFreeBatch(batch);
+        return NULL;
+    }
+
+    if (threadCount == 0)
+    {
+        threadCount = getProcessorCount();
+    }
+
+    // No point in threads without a grab of documents each
+    size_t grabs = (batch->count + BATCH_DOCUMENTS_PER_GRAB - 1) / BATCH_DOCUMENTS_PER_GRAB;
+    if (threadCount > grabs)
+    {
+        threadCount = grabs > 0 ? (uint32_t) grabs : 1;
+    }
+
+    batch->workerDocuments = (JSONDocument **) allocZeroedMemory(allocator, sizeof(JSONDocument *) * threadCount);
+    BatchWorker *workers = (BatchWorker *) allocZeroedMemory(allocator, sizeof(BatchWorker) * threadCount);
+    void **workerData = (void **) allocZeroedMemory(allocator, sizeof(void *) * threadCount);
+
+    if (!batch->workerDocuments || !workers || !workerData)
+    {
+        freeMemory(allocator, workers);
+        freeMemory(allocator, workerData);
+        JSONFreeBatch(batch);
+        return NULL;
+    }
+
+    volatile size_t nextDocument = 0;
+
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        batch->workerDocuments[i] = JSONCreateDocumentWithAllocator(allocator);
+        if (!batch->workerDocuments[i])
+        {
+            freeMemory(allocator, workers);
+            freeMemory(allocator, workerData);
+            JSONFreeBatch(batch);
+            return NULL;
+        }
+        batch->workerCount++;
+
+        // parseDocumentRoot is called directly, the table is not set by a parse
+        batch->workerDocuments[i]->keyTable = options ? options->keyTable : NULL;
+
+        workers[i].batch = batch;
+        workers[i].document = batch->workerDocuments[i];
+        workers[i].flags = options ? options->flags : (uint32_t) JSON_PARSE_DEFAULT;
+        workers[i].projection = projection.rootMask ? &projection : NULL;
+        workers[i].nextDocument = &nextDocument;
+        workerData[i] = &workers[i];
+    }
+
+    runOnThreads(threadCount, parseBatchDocuments, workerData, allocator);
+
+    freeMemory(allocator, workers);
+    freeMemory(allocator, workerData);
+
+    return batch;
+}
+
+JSON_API void JSONFreeBatch(JSONBatch *batch)
+{
+    if (!batch)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < batch->workerCount; i++)
+    {
+        JSONFreeDocument(batch->workerDocuments[i]);
+    }
+
+    freeMemory(&batch->allocator, batch->workerDocuments);
+    freeMemory(&batch->allocator, batch->documents);
+
+    JSONAllocator allocator = batch->allocator;
+    freeMemory(&allocator, batch);
+}
+
+JSON_API size_t JSONBatchGetCount(JSONBatch *batch)
+{
+    return batch->count;
+}
+
+JSON_API JSONError JSONBatchGetDocument(JSONBatch *batch, size_t index, JSONNode **root)
+{
+    if (index >= batch->count)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    BatchDocument *document = &batch->documents[index];
+    *root = document->error == ERR_NOERROR ? &document->root : NULL;
+
+    return document->error;
+}
+
+JSON_API JSONError JSONBatchGetNext(JSONBatch *batch, JSONNode **root)
+{
+    if (batch->next >= batch->count)
+    {
+        return ERR_ITERATOR_NO_MORE_ELEMENTS;
+    }
+
+    return JSONBatchGetDocument(batch, batch->next++, root);
+}
@@ -0,0 +1,911 @@
+#include "json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+// Parses every corpus several times and reports, for the parse, iterate and
+// free phases separately, the best throughput, the allocations and the peak
+// memory. The standard corpora (twitter.json, canada.json, citm_catalog.json)
+// are given on the command line, synthetic ones are always generated.
+//
+//   bench [-r repeats] [-f parseFlags] [-o results.tsv] [-c baseline.tsv] [-t percent] [-a] [files...]
+//
+// -o saves the results, -c compares them with the ones saved by another build
+// and fails when a throughput dropped by more than -t percent (5 by default).
+// -a measures nothing, it parses every corpus twice with the same document or
+// parser through each parse API and fails if the second parse allocates. The
+// tests program checks the same on every build.
+
+#define BENCH_MAX_CORPORA 64
+#define SYNTHETIC_CORPUS_COUNT 4
+#define BENCH_MAX_RESULTS (BENCH_MAX_CORPORA * 3)
+#define BENCH_CHUNK_SIZE (64 * 1024)
+
+enum BenchPhase
+{
+    PHASE_PARSE,
+    PHASE_ITERATE,
+    PHASE_FREE,
+    PHASE_COUNT
+};
+
+const char *phaseNames[PHASE_COUNT] = { "parse", "iterate", "free" };
+
+struct Corpus
+{
+    char name[64];
+    char *data;
+    size_t length;
+};
+
+struct PhaseResult
+{
+    double bestSeconds;
+    size_t allocations;  // during one run of the phase
+    size_t peakHeapBytes; // highest live bytes of the library during the phase
+    size_t peakRssKB;    // of the process once the phase ran, see getPeakRssKB
+};
+
+struct SavedResult
+{
+    char corpus[64];
+    char phase[16];
+    double megabytesPerSecond;
+};
+
+//
+// Measurements
+//
+
+double getSeconds()
+{
+#if defined(_WIN32)
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+#else
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (double) now.tv_sec + (double) now.tv_nsec * 1e-9;
+#endif
+}
+
+// NOTE(vincent): the peak only ever grows, except on Linux where it is reset
+// before each phase so every phase reports its own.
+void resetPeakRss()
+{
+#if defined(__linux__)
+    FILE *file = fopen("/proc/self/clear_refs", "w");
+    if (file)
+    {
+        fputs("5", file);
+        fclose(file);
+    }
+#endif
+}
+
+size_t getPeakRssKB()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+
+    return counters.PeakWorkingSetSize / 1024;
+#elif defined(__linux__)
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file)
+    {
+        char line[256];
+        size_t peak = 0;
+
+        while (fgets(line, sizeof(line), file))
+        {
+            if (strncmp(line, "VmHWM:", 6) == 0)
+            {
+                peak = (size_t) strtoull(line + 6, NULL, 10);
+                break;
+            }
+        }
+
+        fclose(file);
+        return peak;
+    }
+
+    return 0;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (size_t) usage.ru_maxrss / 1024; // bytes on macOS
+#endif
+}
+
+// Allocator counting what the library asks for, the size is kept in front of
+// each block to follow the live bytes.
+struct CountingAllocator
+{
+    size_t allocations;
+    size_t liveBytes;
+    size_t peakBytes;
+};
+
+#define BLOCK_HEADER_SIZE 16
+
+void* countingAlloc(void *userData, size_t size)
+{
+    CountingAllocator *counter = (CountingAllocator *) userData;
+
+    char *block = (char *) malloc(BLOCK_HEADER_SIZE + size);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    *(size_t *) block = size;
+
+    counter->allocations++;
+    counter->liveBytes += size;
+    if (counter->liveBytes > counter->peakBytes)
+    {
+        counter->peakBytes = counter->liveBytes;
+    }
+
+    return block + BLOCK_HEADER_SIZE;
+}
+
+void countingFree(void *userData, void *ptr)
+{
+    CountingAllocator *counter = (CountingAllocator *) userData;
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    char *block = (char *) ptr - BLOCK_HEADER_SIZE;
+    counter->liveBytes -= *(size_t *) block;
+
+    free(block);
+}
+
+void* countingRealloc(void *userData, void *ptr, size_t size)
+{
+    CountingAllocator *counter = (CountingAllocator *) userData;
+
+    if (!ptr)
+    {
+        return countingAlloc(userData, size);
+    }
+
+    char *block = (char *) ptr - BLOCK_HEADER_SIZE;
+    size_t oldSize = *(size_t *) block;
+
+    char *newBlock = (char *) realloc(block, BLOCK_HEADER_SIZE + size);
+    if (!newBlock)
+    {
+        return NULL;
+    }
+
+    *(size_t *) newBlock = size;
+
+    counter->allocations++;
+    counter->liveBytes += size - oldSize;
+    if (counter->liveBytes > counter->peakBytes)
+    {
+        counter->peakBytes = counter->liveBytes;
+    }
+
+    return newBlock + BLOCK_HEADER_SIZE;
+}
+
+
+//
+// Corpora
+//
+
+struct TextBuilder
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+void appendText(TextBuilder *builder, const char *text, size_t length)
+{
+    if (builder->length + length + 1 > builder->capacity)
+    {
+        size_t newCapacity = builder->capacity ? builder->capacity * 2 : (1 << 20);
+        while (newCapacity < builder->length + length + 1)
+        {
+            newCapacity *= 2;
+        }
+
+        char *data = (char *) realloc(builder->data, newCapacity);
+        if (!data)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        builder->data = data;
+        builder->capacity = newCapacity;
+    }
+
+    memcpy(builder->data + builder->length, text, length);
+    builder->length += length;
+    builder->data[builder->length] = '\0';
+}
+
+void appendString(TextBuilder *builder, const char *text)
+{
+    appendText(builder, text, strlen(text));
+}
+
+// Deterministic, so every build parses the same synthetic corpora
+uint32_t nextRandom(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+// Objects and arrays nested 256 deep, many times
+void generateDeep(TextBuilder *builder)
+{
+    appendString(builder, "[");
+    for (int i = 0; i < 2000; i++)
+    {
+        appendString(builder, i ? ",\n" : "\n");
+
+        for (int depth = 0; depth < 128; depth++)
+        {
+            appendString(builder, "{\"child\": [");
+        }
+        appendString(builder, "true");
+        for (int depth = 0; depth < 128; depth++)
+        {
+            appendString(builder, "]}");
+        }
+    }
+    appendString(builder, "\n]\n");
+}
+
+// One object with a lot of keys
+void generateWide(TextBuilder *builder)
+{
+    char text[64];
+
+    appendString(builder, "{");
+    for (int i = 0; i < 200000; i++)
+    {
+        int length = sprintf(text, "%s\n    \"key_%d\": %d", i ? "," : "", i, i);
+        appendText(builder, text, (size_t) length);
+    }
+    appendString(builder, "\n}\n");
+}
+
+void generateNumbers(TextBuilder *builder)
+{
+    char text[64];
+    uint32_t state = 0x12345678;
+
+    appendString(builder, "[");
+    for (int i = 0; i < 500000; i++)
+    {
+        uint32_t random = nextRandom(&state);
+        int length;
+
+        switch (random % 4)
+        {
+            case 0:  length = sprintf(text, "%d", (int) (random >> 2) - (1 << 29)); break;
+            case 1:  length = sprintf(text, "%.17g", (double) random / 4294967296.0); break;
+            case 2:  length = sprintf(text, "%.6f", (double) (random % 100000) / 7.0); break;
+            default: length = sprintf(text, "%.10e", (double) random * 1e-200); break;
+        }
+
+        appendString(builder, i ? "," : "");
+        appendText(builder, text, (size_t) length);
+    }
+    appendString(builder, "]\n");
+}
+
+void generateStrings(TextBuilder *builder)
+{
+    static const char *words[] = {
+        "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+        "caf\\u00e9", "tab\\there", "line\\nbreak", "\\\"quoted\\\"", "back\\\\slash", "na\\u00efve"
+    };
+    uint32_t state = 0x9abcdef0;
+
+    appendString(builder, "[");
+    for (int i = 0; i < 200000; i++)
+    {
+        appendString(builder, i ? ",\n\"" : "\n\"");
+
+        uint32_t wordCount = 1 + nextRandom(&state) % 12;
+        for (uint32_t j = 0; j < wordCount; j++)
+        {
+            if (j)
+            {
+                appendString(builder, " ");
+            }
+
+            // Escapes are rarer than plain words, as in most documents
+            uint32_t random = nextRandom(&state);
+            uint32_t word = random % 64 == 0 ? 8 + (random >> 6) % 6 : (random >> 6) % 8;
+            appendString(builder, words[word]);
+        }
+
+        appendString(builder, "\"");
+    }
+    appendString(builder, "\n]\n");
+}
+
+bool readCorpus(Corpus *corpus, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    corpus->data = (char *) malloc((size_t) length + 1);
+    if (!corpus->data || fread(corpus->data, 1, (size_t) length, file) != (size_t) length)
+    {
+        free(corpus->data);
+        fclose(file);
+        return false;
+    }
+
+    fclose(file);
+
+    corpus->length = (size_t) length;
+    corpus->data[length] = '\0';
+
+    // Only the file name, the path differs between machines
+    const char *name = path;
+    for (const char *ptr = path; *ptr; ptr++)
+    {
+        if (*ptr == '/' || *ptr == '\\')
+        {
+            name = ptr + 1;
+        }
+    }
+    snprintf(corpus->name, sizeof(corpus->name), "%s", name);
+
+    return true;
+}
+
+void addSyntheticCorpus(Corpus *corpus, const char *name, void (*generate)(TextBuilder *))
+{
+    TextBuilder builder = {};
+    generate(&builder);
+
+    snprintf(corpus->name, sizeof(corpus->name), "%s", name);
+    corpus->data = builder.data;
+    corpus->length = builder.length;
+}
+
+//
+// Phases
+//
+
+// Reads every value through the public API, as a program using the tree would
+size_t iterateNode(JSONNode *node, const JSONAllocator *allocator)
+{
+    size_t checksum = 0;
+
+    switch (JSONGetNodeType(node))
+    {
+        case OBJECT_NODE:
+        case ARRAY_NODE:
+        {
+            bool isObject = JSONGetNodeType(node) == OBJECT_NODE;
+
+            JSONIterator *iter = JSONCreateIteratorWithAllocator(node, allocator);
+            JSONString *key;
+            JSONNode *value;
+
+            while (JSONIteratorGetNext(iter, isObject ? &key : NULL, &value) == ERR_NOERROR)
+            {
+                if (isObject)
+                {
+                    checksum += JSONStringGetLength(key);
+                }
+                checksum += iterateNode(value, allocator);
+            }
+
+            JSONFreeIterator(iter);
+            break;
+        }
+        case STRING_NODE:
+        {
+            JSONString *string = JSONNodeGetString(node);
+            checksum += JSONStringGetLength(string) + (unsigned char) JSONStringGetData(string)[0];
+            break;
+        }
+        case INTEGER_NODE:
+        {
+            checksum += (size_t) JSONNodeGetInteger(node);
+            break;
+        }
+        case DOUBLE_NODE:
+        {
+            checksum += (size_t) (JSONNodeGetDouble(node) * 1000.0);
+            break;
+        }
+        case BOOLEAN_NODE:
+        {
+            checksum += JSONNodeGetBool(node);
+            break;
+        }
+        default:
+        {
+            checksum++;
+            break;
+        }
+    }
+
+    return checksum;
+}
+
+bool benchCorpus(Corpus *corpus, uint32_t flags, int repeats, PhaseResult *results)
+{
+    CountingAllocator counter = {};
+    JSONAllocator allocator = { countingAlloc, countingRealloc, countingFree, &counter };
+
+    JSONParseOptions options = {};
+    options.flags = flags;
+    options.allocator = &allocator;
+
+    for (int phase = 0; phase < PHASE_COUNT; phase++)
+    {
+        results[phase].bestSeconds = 1e30;
+    }
+
+    size_t firstChecksum = 0;
+
+    for (int repeat = 0; repeat < repeats; repeat++)
+    {
+        // NOTE(vincent): a new document each time, reusing it would hide the
+        // allocations of the parse phase after the first run.
+        JSONDocument *document = JSONCreateDocumentWithAllocator(&allocator);
+        if (!document)
+        {
+            fprintf(stderr, "%s: out of memory\n", corpus->name);
+            return false;
+        }
+
+        double phaseSeconds[PHASE_COUNT];
+        size_t phaseAllocations[PHASE_COUNT];
+        size_t phasePeakBytes[PHASE_COUNT];
+        size_t phasePeakRss[PHASE_COUNT];
+        size_t checksum = 0;
+
+        for (int phase = 0; phase < PHASE_COUNT; phase++)
+        {
+            resetPeakRss();
+            counter.allocations = 0;
+            counter.peakBytes = counter.liveBytes;
+
+            double start = getSeconds();
+
+            if (phase == PHASE_PARSE)
+            {
+                JSONError error = JSONParseDocument(document, corpus->data, corpus->length, &options);
+                if (error != ERR_NOERROR)
+                {
+                    fprintf(stderr, "%s: parse error %d\n", corpus->name, error);
+                    JSONFreeDocument(document);
+                    return false;
+                }
+            }
+            else if (phase == PHASE_ITERATE)
+            {
+                checksum = iterateNode(JSONDocumentGetRoot(document), &allocator);
+            }
+            else
+            {
+                JSONFreeDocument(document);
+            }
+
+            phaseSeconds[phase] = getSeconds() - start;
+            phaseAllocations[phase] = counter.allocations;
+            phasePeakBytes[phase] = counter.peakBytes;
+            phasePeakRss[phase] = getPeakRssKB();
+        }
+
+        // Also keeps the compiler from dropping the iteration
+        if (repeat == 0)
+        {
+            firstChecksum = checksum;
+        }
+        else if (checksum != firstChecksum)
+        {
+            fprintf(stderr, "%s: the tree differs between runs\n", corpus->name);
+            return false;
+        }
+
+        for (int phase = 0; phase < PHASE_COUNT; phase++)
+        {
+            if (phaseSeconds[phase] < results[phase].bestSeconds)
+            {
+                results[phase].bestSeconds = phaseSeconds[phase];
+            }
+
+            results[phase].allocations = phaseAllocations[phase];
+            results[phase].peakHeapBytes = phasePeakBytes[phase];
+            results[phase].peakRssKB = phasePeakRss[phase];
+        }
+    }
+
+    if (counter.liveBytes != 0)
+    {
+        fprintf(stderr, "%s: %zu bytes leaked\n", corpus->name, counter.liveBytes);
+        return false;
+    }
+
+    return true;
+}
+
+//
+// Allocation check
+//
+
+enum ParseApi
+{
+    API_PARSE_DOCUMENT,
+    API_PARSE, // JSONParseDocument without options, what JSONParse does
+    API_PARSER,
+    API_COUNT
+};
+
+const char *apiNames[API_COUNT] = { "JSONParseDocument", "JSONParse", "JSONParser" };
+
+JSONError feedParser(JSONParser *parser, Corpus *corpus)
+{
+    JSONError error;
+
+    JSONParserReset(parser);
+
+    for (size_t offset = 0; offset < corpus->length; offset += BENCH_CHUNK_SIZE)
+    {
+        size_t length = corpus->length - offset < BENCH_CHUNK_SIZE ? corpus->length - offset : BENCH_CHUNK_SIZE;
+        if ((error = JSONParserFeed(parser, corpus->data + offset, length)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    return JSONParserFinish(parser);
+}
+
+// Fills the allocations of the first and second parse for each API
+bool checkCorpusAllocations(Corpus *corpus, uint32_t flags, size_t allocations[API_COUNT][2])
+{
+    CountingAllocator counter = {};
+    JSONAllocator allocator = { countingAlloc, countingRealloc, countingFree, &counter };
+
+    JSONParseOptions options = {};
+    options.flags = flags;
+    options.allocator = &allocator;
+
+    JSONDocument *document = JSONCreateDocumentWithAllocator(&allocator);
+    JSONDocument *defaultDocument = JSONCreateDocumentWithAllocator(&allocator);
+    JSONDocument *parserDocument = JSONCreateDocumentWithAllocator(&allocator);
+    JSONParser *parser = parserDocument ? JSONCreateParser(parserDocument, &options) : NULL;
+
+    bool succeeded = document && defaultDocument && parser;
+
+    for (int api = 0; api < API_COUNT && succeeded; api++)
+    {
+        for (int run = 0; run < 2 && succeeded; run++)
+        {
+            JSONError error;
+
+            counter.allocations = 0;
+
+            if (api == API_PARSE_DOCUMENT)
+            {
+                error = JSONParseDocument(document, corpus->data, corpus->length, &options);
+            }
+            else if (api == API_PARSE)
+            {
+                error = JSONParseDocument(defaultDocument, corpus->data, corpus->length, NULL);
+            }
+            else
+            {
+                error = feedParser(parser, corpus);
+            }
+
+            if (error != ERR_NOERROR)
+            {
+                fprintf(stderr, "%s: %s error %d\n", corpus->name, apiNames[api], error);
+                succeeded = false;
+            }
+
+            allocations[api][run] = counter.allocations;
+        }
+    }
+
+    JSONFreeParser(parser);
+    JSONFreeDocument(parserDocument);
+    JSONFreeDocument(defaultDocument);
+    JSONFreeDocument(document);
+
+    if (succeeded && counter.liveBytes != 0)
+    {
+        fprintf(stderr, "%s: %zu bytes leaked\n", corpus->name, counter.liveBytes);
+        succeeded = false;
+    }
+
+    return succeeded;
+}
+
+int checkAllocations(Corpus *corpora, int corpusCount, uint32_t flags)
+{
+    printf("%-22s %-18s %14s %14s\n", "corpus", "api", "first allocs", "second allocs");
+
+    int failures = 0;
+
+    for (int i = 0; i < corpusCount; i++)
+    {
+        Corpus *corpus = &corpora[i];
+        size_t allocations[API_COUNT][2];
+
+        if (!checkCorpusAllocations(corpus, flags, allocations))
+        {
+            failures++;
+            continue;
+        }
+
+        for (int api = 0; api < API_COUNT; api++)
+        {
+            bool allocated = allocations[api][1] != 0;
+            printf("%-22s %-18s %14zu %14zu%s\n", corpus->name, apiNames[api], allocations[api][0],
+                   allocations[api][1], allocated ? "  ALLOCATES" : "");
+
+            if (allocated)
+            {
+                failures++;
+            }
+        }
+
+        free(corpus->data);
+    }
+
+    if (failures)
+    {
+        printf("%d parse(s) failed or allocated once warmed up\n", failures);
+    }
+
+    return failures ? 1 : 0;
+}
+
+//
+// Comparison
+//
+
+size_t loadResults(const char *path, SavedResult *results, size_t capacity)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return 0;
+    }
+
+    char line[256];
+    size_t count = 0;
+
+    while (count < capacity && fgets(line, sizeof(line), file))
+    {
+        SavedResult *result = &results[count];
+        if (sscanf(line, "%63s %15s %lf", result->corpus, result->phase, &result->megabytesPerSecond) == 3)
+        {
+            count++;
+        }
+    }
+
+    fclose(file);
+
+    return count;
+}
+
+const SavedResult* findResult(const SavedResult *results, size_t count, const char *corpus, const char *phase)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (strcmp(results[i].corpus, corpus) == 0 && strcmp(results[i].phase, phase) == 0)
+        {
+            return &results[i];
+        }
+    }
+
+    return NULL;
+}
+
+void printUsage()
+{
+    fprintf(stderr, "usage: bench [-r repeats] [-f parseFlags] [-o results.tsv] [-c baseline.tsv] [-t percent] "
+                    "[-a] [files...]\n");
+}
+
+int main(int argc, char **argv)
+{
+    int repeats = 10;
+    uint32_t flags = JSON_PARSE_DEFAULT;
+    const char *outputPath = NULL;
+    const char *baselinePath = NULL;
+    double threshold = 5.0;
+    bool allocationCheck = false;
+
+    static Corpus corpora[BENCH_MAX_CORPORA];
+    int corpusCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (strcmp(arg, "-r") == 0 && hasValue)
+        {
+            repeats = atoi(argv[++i]);
+        }
+        else if (strcmp(arg, "-f") == 0 && hasValue)
+        {
+            flags = (uint32_t) strtoul(argv[++i], NULL, 0);
+        }
+        else if (strcmp(arg, "-o") == 0 && hasValue)
+        {
+            outputPath = argv[++i];
+        }
+        else if (strcmp(arg, "-c") == 0 && hasValue)
+        {
+            baselinePath = argv[++i];
+        }
+        else if (strcmp(arg, "-t") == 0 && hasValue)
+        {
+            threshold = atof(argv[++i]);
+        }
+        else if (strcmp(arg, "-a") == 0)
+        {
+            allocationCheck = true;
+        }
+        else if (arg[0] == '-')
+        {
+            printUsage();
+            return 2;
+        }
+        else if (corpusCount == BENCH_MAX_CORPORA - SYNTHETIC_CORPUS_COUNT)
+        {
+            fprintf(stderr, "too many files\n");
+            return 2;
+        }
+        else if (!readCorpus(&corpora[corpusCount++], arg))
+        {
+            fprintf(stderr, "cannot read %s\n", arg);
+            return 2;
+        }
+    }
+
+    if (repeats < 1)
+    {
+        repeats = 1;
+    }
+
+    addSyntheticCorpus(&corpora[corpusCount++], "synthetic_deep", generateDeep);
+    addSyntheticCorpus(&corpora[corpusCount++], "synthetic_wide", generateWide);
+    addSyntheticCorpus(&corpora[corpusCount++], "synthetic_numbers", generateNumbers);
+    addSyntheticCorpus(&corpora[corpusCount++], "synthetic_strings", generateStrings);
+
+    if (allocationCheck)
+    {
+        return checkAllocations(corpora, corpusCount, flags);
+    }
+
+    static SavedResult baseline[BENCH_MAX_RESULTS];
+    size_t baselineCount = 0;
+    if (baselinePath)
+    {
+        baselineCount = loadResults(baselinePath, baseline, BENCH_MAX_RESULTS);
+        if (baselineCount == 0)
+        {
+            fprintf(stderr, "no results in %s\n", baselinePath);
+            return 2;
+        }
+    }
+
+    FILE *output = NULL;
+    if (outputPath)
+    {
+        output = fopen(outputPath, "w");
+        if (!output)
+        {
+            fprintf(stderr, "cannot write %s\n", outputPath);
+            return 2;
+        }
+    }
+
+    printf("%-22s %10s %-8s %10s %10s %12s %12s%s\n", "corpus", "KB", "phase", "MB/s", "allocs", "heap KB",
+           "peak RSS KB", baselinePath ? "   vs baseline" : "");
+
+    int failures = 0;
+    int regressions = 0;
+
+    for (int i = 0; i < corpusCount; i++)
+    {
+        Corpus *corpus = &corpora[i];
+        PhaseResult results[PHASE_COUNT];
+
+        if (!benchCorpus(corpus, flags, repeats, results))
+        {
+            failures++;
+            continue;
+        }
+
+        for (int phase = 0; phase < PHASE_COUNT; phase++)
+        {
+            PhaseResult *result = &results[phase];
+            double megabytesPerSecond = (double) corpus->length / (1024.0 * 1024.0) / result->bestSeconds;
+
+            printf("%-22s %10zu %-8s %10.1f %10zu %12zu %12zu", corpus->name, corpus->length / 1024,
+                   phaseNames[phase], megabytesPerSecond, result->allocations, result->peakHeapBytes / 1024,
+                   result->peakRssKB);
+
+            const SavedResult *previous = findResult(baseline, baselineCount, corpus->name, phaseNames[phase]);
+            if (previous)
+            {
+                double change = (megabytesPerSecond / previous->megabytesPerSecond - 1.0) * 100.0;
+                bool regressed = change < -threshold;
+
+                printf("   %+7.1f%%%s", change, regressed ? "  REGRESSION" : "");
+                if (regressed)
+                {
+                    regressions++;
+                }
+            }
+            printf("\n");
+
+            if (output)
+            {
+                fprintf(output, "%s\t%s\t%.3f\t%zu\t%zu\t%zu\n", corpus->name, phaseNames[phase], megabytesPerSecond,
+                        result->allocations, result->peakHeapBytes, result->peakRssKB);
+            }
+        }
+
+        free(corpus->data);
+    }
+
+    if (output)
+    {
+        fclose(output);
+    }
+
+    if (regressions)
+    {
+        printf("%d phase(s) more than %.1f%% slower than the baseline\n", regressions, threshold);
+    }
+
+    return failures || regressions ? 1 : 0;
+}
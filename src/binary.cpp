@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "json_private.h"
+#include "mapping.h"
+#include "tape.h"
+#include "json.h"
+
+// Snapshots are a header followed by the words of a tape (see tape.h) with
+// every string copied in it, never a view. Containers hold distances to their
+// end and strings follow their length, nothing in the file is an address: once
+// mapped, the node API reads the words in place.
+#define BINARY_MAGIC "cjsontap"
+#define BINARY_VERSION 1
+
+// Stored as is, so it reads differently on a machine of the other byte order
+#define BINARY_BYTE_ORDER 0x01020304u
+
+// Nesting checked without allocating, deeper snapshots grow the stack
+#define TAPE_CHECK_LOCAL_DEPTH 64
+
+//
+// Binary private API
+//
+
+// A multiple of 8 bytes, the words after it stay aligned in the mapping
+struct BinaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t wordCount;
+};
+
+JSONError appendNodeToTape(TapeBuilder *builder, JSONNode *node)
+{
+    JSONError error;
+    JSONNodeType type = JSONGetNodeType(node);
+
+    switch (type)
+    {
+        case OBJECT_NODE:
+        case ARRAY_NODE:
+        {
+            if ((error = emitStartContainer(builder, type)) != ERR_NOERROR)
+            {
+                return error;
+            }
+
+            JSONIterator iter;
+            initIterator(&iter, node);
+
+            JSONString *key;
+            JSONNode *value;
+            while ((error = JSONIteratorGetNext(&iter, &key, &value)) == ERR_NOERROR)
+            {
+                if (type == OBJECT_NODE
+                        && (error = emitKey(builder, JSONStringGetData(key), JSONStringGetLength(key), false))
+                            != ERR_NOERROR)
+                {
+                    return error;
+                }
+
+                if ((error = appendNodeToTape(builder, value)) != ERR_NOERROR)
+                {
+                    return error;
+                }
+            }
+
+            if (error != ERR_ITERATOR_NO_MORE_ELEMENTS)
+            {
+                return error;
+            }
+
+            return emitEndContainer(builder, type);
+        }
+        case STRING_NODE:
+        {
+            JSONString *string = JSONNodeGetString(node);
+
+            return emitString(builder, JSONStringGetData(string), JSONStringGetLength(string), false);
+        }
+        case INTEGER_NODE:
+        {
+            return emitInteger(builder, JSONNodeGetInteger(node));
+        }
+        case DOUBLE_NODE:
+        {
+            return emitDouble(builder, JSONNodeGetDouble(node));
+        }
+        case BOOLEAN_NODE:
+        {
+            return emitBoolean(builder, JSONNodeGetBool(node));
+        }
+        case NULL_NODE:
+        {
+            return emitNull(builder);
+        }
+        default:
+        {
+            return ERR_INVALID_TREE_SYNTAX;
+        }
+    }
+}
+
+// Returns the word after the scalar starting at word, or NULL when it is not
+// well formed or does not end before end
+const uint64_t* checkTapeScalar(const uint64_t *word, const uint64_t *end)
+{
+    uint64_t payload = getTapePayload(*word);
+    uint64_t available = (uint64_t) (end - word);
+
+    switch (getTapeTag(*word))
+    {
+        case TAPE_STRING:
+        {
+            uint64_t dataWords = (payload + 8) / 8;
+            if (dataWords >= available || ((const char *) (word + 1))[payload] != '\0')
+            {
+                return NULL;
+            }
+
+            return word + 1 + dataWords;
+        }
+        case TAPE_INTEGER:
+        case TAPE_DOUBLE:
+        {
+            return available >= 2 ? word + 2 : NULL;
+        }
+        case TAPE_TRUE:
+        case TAPE_FALSE:
+        case TAPE_NULL:
+        {
+            return word + 1;
+        }
+        default:
+        {
+            return NULL;
+        }
+    }
+}
+
+// Start words of the containers being checked, from the root to the innermost
+struct TapeCheckStack
+{
+    const uint64_t **starts;
+    size_t count;
+    size_t capacity;
+
+    const JSONAllocator *allocator;
+    const uint64_t *localStarts[TAPE_CHECK_LOCAL_DEPTH];
+};
+
+JSONError pushTapeContainer(TapeCheckStack *stack, const uint64_t *start)
+{
+    if (stack->count == stack->capacity)
+    {
+        size_t newCapacity = stack->capacity * 2;
+        const uint64_t **starts = (const uint64_t **) allocMemory(stack->allocator, newCapacity * sizeof(*starts));
+        if (!starts)
+        {
+            return ERR_OUT_OF_MEMORY;
+        }
+
+        memcpy(starts, stack->starts, stack->count * sizeof(*starts));
+        if (stack->starts != stack->localStarts)
+        {
+            freeMemory(stack->allocator, stack->starts);
+        }
+
+        stack->starts = starts;
+        stack->capacity = newCapacity;
+    }
+
+    stack->starts[stack->count++] = start;
+
+    return ERR_NOERROR;
+}
+
+// Checks that the words from word to end hold exactly one well formed value.
+// Once it accepts them, the node API can walk the words without ever leaving
+// them. The file is untrusted, containers are followed with an explicit stack
+// rather than recursion so no nesting can overflow the call stack.
+JSONError checkTapeWords(const uint64_t *word, const uint64_t *end, const JSONAllocator *allocator)
+{
+    TapeCheckStack stack;
+    stack.starts = stack.localStarts;
+    stack.count = 0;
+    stack.capacity = TAPE_CHECK_LOCAL_DEPTH;
+    stack.allocator = allocator;
+
+    JSONError error = ERR_INVALID_BINARY;
+
+    for (;;)
+    {
+        const uint64_t *start = stack.count ? stack.starts[stack.count - 1] : NULL;
+        const uint64_t *close = start ? start + getTapePayload(*start) - 1 : end;
+        bool isObject = start && getTapeTag(*start) == TAPE_OBJECT_START;
+
+        if (start && word == close)
+        {
+            if (*close != makeTapeWord(isObject ? TAPE_OBJECT_END : TAPE_ARRAY_END, getTapePayload(*start) - 1))
+            {
+                break;
+            }
+
+            stack.count--;
+            word = close + 1;
+        }
+        else
+        {
+            if (isObject && (getTapeTag(*word) != TAPE_STRING || !(word = checkTapeScalar(word, close))
+                    || word == close))
+            {
+                break;
+            }
+
+            TapeTag tag = getTapeTag(*word);
+            if (tag == TAPE_OBJECT_START || tag == TAPE_ARRAY_START)
+            {
+                uint64_t payload = getTapePayload(*word);
+                if (payload < 2 || payload > (uint64_t) (close - word))
+                {
+                    break;
+                }
+
+                if ((error = pushTapeContainer(&stack, word)) != ERR_NOERROR)
+                {
+                    break;
+                }
+
+                error = ERR_INVALID_BINARY;
+                word++;
+                continue;
+            }
+
+            if (!(word = checkTapeScalar(word, close)))
+            {
+                break;
+            }
+        }
+
+        if (!stack.count)
+        {
+            if (word == end)
+            {
+                error = ERR_NOERROR;
+            }
+            break;
+        }
+    }
+
+    if (stack.starts != stack.localStarts)
+    {
+        freeMemory(allocator, stack.starts);
+    }
+
+    return error;
+}
+
+JSONError writeBinaryFile(const char *path, const Tape *tape)
+{
+    BinaryHeader header = {};
+    memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+    header.version = BINARY_VERSION;
+    header.byteOrder = BINARY_BYTE_ORDER;
+    header.wordCount = tape->length;
+
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        return ERR_CANNOT_WRITE_FILE;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(tape->words, sizeof(uint64_t), tape->length, file) == tape->length;
+
+    if (fclose(file) != 0 || !written)
+    {
+        // A truncated snapshot would only be rejected when loaded
+        remove(path);
+        return ERR_CANNOT_WRITE_FILE;
+    }
+
+    return ERR_NOERROR;
+}
+
+//
+// Binary public API
+//
+
+JSON_API JSONError JSONSaveBinary(JSONNode *node, const char *path)
+{
+    return JSONSaveBinaryWithAllocator(node, path, NULL);
+}
+
+JSON_API JSONError JSONSaveBinaryWithAllocator(JSONNode *node, const char *path, const JSONAllocator *allocator)
+{
+    JSONError error;
+
+    if (!node || !path)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    // The tape is only built to be written
+    Tape tape = {};
+    tape.allocator = allocator;
+    TapeBuilder builder = {};
+    builder.tape = &tape;
+
+    if ((error = appendNodeToTape(&builder, node)) == ERR_NOERROR)
+    {
+        error = writeBinaryFile(path, &tape);
+    }
+
+    freeTape(&tape);
+
+    return error;
+}
+
+JSON_API JSONError JSONLoadBinary(JSONDocument *document, const char *path)
+{
+    JSONError error;
+    FileMapping mapping;
+
+    resetDocument(document);
+
+    // Read in place like any document, wherever the lookups go
+    if ((error = mapFile(&mapping, path, false)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    const BinaryHeader *header = (const BinaryHeader *) mapping.data;
+    const uint64_t *words = (const uint64_t *) (header + 1);
+    size_t wordBytes = mapping.length - sizeof(BinaryHeader);
+
+    if (mapping.length <= sizeof(BinaryHeader)
+            || memcmp(header->magic, BINARY_MAGIC, sizeof(header->magic)) != 0
+            || header->version != BINARY_VERSION
+            || header->byteOrder != BINARY_BYTE_ORDER
+            || wordBytes % sizeof(uint64_t) != 0
+            || header->wordCount != wordBytes / sizeof(uint64_t))
+    {
+        unmapFile(&mapping);
+        return ERR_INVALID_BINARY;
+    }
+
+    if ((error = checkTapeWords(words, words + header->wordCount, &document->allocator)) != ERR_NOERROR)
+    {
+        unmapFile(&mapping);
+        return error;
+    }
+
+    document->mapping = mapping;
+    document->snapshot = words;
+
+    return ERR_NOERROR;
+}
@@ -1,22 +1,34 @@
 #include "buffer.h"
+#include "allocator.h"
 
 #include <stdlib.h>
 #include <string.h>
 
-Buffer *newBuffer()
+Buffer *newBuffer(const JSONAllocator *allocator)
 {
-    Buffer *buffer = (Buffer *) malloc(sizeof(Buffer));
+    Buffer *buffer = (Buffer *) allocMemory(allocator, sizeof(Buffer));
+    if (!buffer)
+    {
+        return NULL;
+    }
+
     memset(buffer, 0, sizeof(Buffer));
+    buffer->allocator = allocator;
     buffer->capacity = sizeof(char) * (1 << 16);
-    buffer->underlying = (char *) malloc(buffer->capacity);
+    buffer->underlying = (char *) allocMemory(allocator, buffer->capacity);
+    if (!buffer->underlying)
+    {
+        freeMemory(allocator, buffer);
+        return NULL;
+    }
 
     return buffer;
 }
 
 void freeBuffer(Buffer *buffer)
 {
-    free(buffer->underlying);
-    free(buffer);
+    freeMemory(buffer->allocator, buffer->underlying);
+    freeMemory(buffer->allocator, buffer);
 }
 
 void clearBuffer(Buffer *buffer)
@@ -27,10 +39,11 @@ void clearBuffer(Buffer *buffer)
 JSONError BufferGrow(Buffer *buffer)
 {
     size_t newCapacity = (size_t) (sizeof(char) * buffer->capacity * 1.5f);
-    char *newUnderlying = (char *) malloc(newCapacity);
-
-    memcpy_s(newUnderlying, newCapacity, buffer->underlying, buffer->capacity);
-    free(buffer->underlying);
+    char *newUnderlying = (char *) reallocMemory(buffer->allocator, buffer->underlying, newCapacity);
+    if (!newUnderlying)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
 
     buffer->capacity = newCapacity;
     buffer->underlying = newUnderlying;
@@ -38,9 +51,9 @@ JSONError BufferGrow(Buffer *buffer)
     return ERR_NOERROR;
 }
 
-JSONError putArrayToBuffer(Buffer *buffer, char *data, size_t dataLength)
+JSONError putArrayToBuffer(Buffer *buffer, const char *data, size_t dataLength)
 {
-    if ((buffer->index) + dataLength >= buffer->capacity)
+    while ((buffer->index) + dataLength >= buffer->capacity)
     {
         JSONError error = BufferGrow(buffer);
         if (error != ERR_NOERROR)
@@ -50,7 +63,7 @@ JSONError putArrayToBuffer(Buffer *buffer, char *data, size_t dataLength)
     }
 
     char *ptr = buffer->underlying + buffer->index;
-    memcpy_s(ptr, buffer->capacity - buffer->index, data, dataLength);
+    memcpy(ptr, data, dataLength);
     buffer->index += dataLength;
 
     return ERR_NOERROR;
@@ -90,3 +103,13 @@ char* getDataFromBuffer(Buffer *buffer)
 {
     return buffer->underlying;
 }
+
+// Frees the buffer but not its data, which is returned and must be freed with
+// the allocator of the buffer
+char* detachBufferData(Buffer *buffer)
+{
+    char *data = buffer->underlying;
+    freeMemory(buffer->allocator, buffer);
+
+    return data;
+}
@@ -7,12 +7,15 @@ struct Buffer
     char *underlying;
     size_t capacity;
     size_t index;
+
+    const JSONAllocator *allocator;
 };
 
-Buffer* newBuffer();
+Buffer* newBuffer(const JSONAllocator *allocator);
 void freeBuffer(Buffer *buffer);
 void clearBuffer(Buffer *buffer);
-JSONError putArrayToBuffer(Buffer *buffer, char *data, size_t dataLength);
+JSONError putArrayToBuffer(Buffer *buffer, const char *data, size_t dataLength);
 JSONError copyBuffer(Buffer *dest, Buffer *source);
 JSONError putCharToBuffer(Buffer *buffer, char ch);
 char* getDataFromBuffer(Buffer *buffer);
+char* detachBufferData(Buffer *buffer);
@@ -1,17 +1,46 @@
 @echo off
 
-set CommonCompilerFlags=-nologo -GR- -EHa- -Oi -Od -MT -FC -W4 -WX -wd4100 -Zi
+REM build.bat [release|debug], build.sh is the Linux/macOS counterpart
+REM Set STATS=1 to fill JSONParseStats
 
-set LibSources=..\json\src\json.cpp ..\json\src\buffer.cpp
+set Config=%1
+IF "%Config%"=="" set Config=release
+
+set CommonCompilerFlags=-nologo -GR- -EHa- -Oi -MT -FC -W4 -WX -wd4100 -Zi
+set CommonLinkerFlags=-opt:ref
+set LibrarianFlags=-nologo
+
+IF "%Config%"=="debug" (
+    set CommonCompilerFlags=%CommonCompilerFlags% -Od
+) ELSE (
+    set CommonCompilerFlags=%CommonCompilerFlags% -O2 -GL -DNDEBUG
+    set CommonLinkerFlags=%CommonLinkerFlags% -LTCG
+    set LibrarianFlags=%LibrarianFlags% -LTCG
+)
+
+IF "%STATS%"=="1" set CommonCompilerFlags=%CommonCompilerFlags% /DJSON_STATS
+
+set LibSources=..\json\src\json.cpp ..\json\src\buffer.cpp ..\json\src\arena.cpp ..\json\src\structural.cpp ..\json\src\number.cpp ..\json\src\writer.cpp ..\json\src\stream.cpp ..\json\src\thread.cpp ..\json\src\batch.cpp ..\json\src\parallel.cpp ..\json\src\mapping.cpp ..\json\src\tape.cpp ..\json\src\allocator.cpp ..\json\src\utf8.cpp ..\json\src\stats.cpp ..\json\src\path.cpp ..\json\src\binary.cpp ..\json\src\keytable.cpp
 set ExampleSources=..\json\src\example.cpp
+set BenchSources=..\json\src\bench.cpp
+set TestSources=..\json\src\tests.cpp
 
 set BuildDir=..\..\json-build
 
 IF NOT EXIST %BuildDir% mkdir %BuildDir%
 pushd %BuildDir%
 
-cl %CommonCompilerFlags% /DBUILDING_JSON %LibSources% -Fm:json.map /LD
+cl %CommonCompilerFlags% /DBUILDING_JSON %LibSources% -Fm:json.map /LD /link %CommonLinkerFlags%
+
+REM Static library, its users define JSON_STATIC
+IF NOT EXIST static mkdir static
+cl %CommonCompilerFlags% /DJSON_STATIC /c %LibSources% -Fo:static\
+lib %LibrarianFlags% static\*.obj -OUT:json_static.lib
+
+cl %CommonCompilerFlags% %ExampleSources% -Fm:example.map /link %CommonLinkerFlags% ws2_32.lib json.lib
+
+cl %CommonCompilerFlags% %BenchSources% -Fm:bench.map /link %CommonLinkerFlags% psapi.lib json.lib
 
-cl %CommonCompilerFlags% %ExampleSources% -Fm:example.map /link -opt:ref ws2_32.lib json.lib
+cl %CommonCompilerFlags% %TestSources% -Fm:tests.map /link %CommonLinkerFlags% json.lib
 
 popd
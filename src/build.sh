@@ -0,0 +1,77 @@
+#!/bin/sh
+#
+# Linux/macOS counterpart of build.bat: builds libjson.a, libjson.so, the
+# bench and the tests with GCC or Clang.
+#
+#   ./build.sh [release|debug]
+#
+# CXX picks the compiler, NATIVE=1 adds -march=native, LTO=0 disables link
+# time optimization of the release build, STATS=1 fills JSONParseStats.
+
+set -e
+
+Config=${1:-release}
+CXX=${CXX:-c++}
+
+SrcDir=$(cd "$(dirname "$0")" && pwd)
+BuildDir=${BuildDir:-$SrcDir/../../json-build}
+
+LibSources="json.cpp buffer.cpp arena.cpp structural.cpp number.cpp writer.cpp stream.cpp thread.cpp batch.cpp
+            parallel.cpp mapping.cpp tape.cpp allocator.cpp utf8.cpp stats.cpp path.cpp binary.cpp keytable.cpp"
+BenchSources="bench.cpp"
+TestSources="tests.cpp"
+
+CommonCompilerFlags="-std=c++11 -fno-rtti -fno-exceptions -Wall -Wextra -Werror -Wno-unused-parameter -g"
+
+case "$Config" in
+    release)
+        CommonCompilerFlags="$CommonCompilerFlags -O3 -DNDEBUG"
+        if [ "${LTO:-1}" = "1" ]; then
+            CommonCompilerFlags="$CommonCompilerFlags -flto"
+        fi
+        ;;
+    debug)
+        CommonCompilerFlags="$CommonCompilerFlags -O0"
+        ;;
+    *)
+        echo "usage: $0 [release|debug]" >&2
+        exit 2
+        ;;
+esac
+
+if [ "${NATIVE:-0}" = "1" ]; then
+    CommonCompilerFlags="$CommonCompilerFlags -march=native"
+fi
+
+if [ "${STATS:-0}" = "1" ]; then
+    CommonCompilerFlags="$CommonCompilerFlags -DJSON_STATS"
+fi
+
+# The plain ar cannot index LTO objects
+if $CXX --version | grep -q clang; then
+    AR=${AR:-llvm-ar}
+else
+    AR=${AR:-gcc-ar}
+fi
+
+mkdir -p "$BuildDir/obj"
+cd "$BuildDir"
+
+# Only JSON_API functions are exported, everything else can be inlined across
+# the library and dropped
+LibObjects=""
+for Source in $LibSources; do
+    Object="obj/${Source%.cpp}.o"
+    $CXX $CommonCompilerFlags -fPIC -fvisibility=hidden -DBUILDING_JSON -c "$SrcDir/$Source" -o "$Object"
+    LibObjects="$LibObjects $Object"
+done
+
+rm -f libjson.a
+$AR rcs libjson.a $LibObjects
+$CXX $CommonCompilerFlags -shared -fPIC $LibObjects -o libjson.so -lpthread
+
+$CXX $CommonCompilerFlags $(for Source in $BenchSources; do echo "$SrcDir/$Source"; done) -o bench \
+    -L. -ljson -Wl,-rpath,'$ORIGIN' -lpthread
+
+$CXX $CommonCompilerFlags $(for Source in $TestSources; do echo "$SrcDir/$Source"; done) -o tests \
+    -L. -ljson -Wl,-rpath,'$ORIGIN' -lpthread
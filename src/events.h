@@ -0,0 +1,257 @@
+#pragma once
+
+#include "json_private.h"
+#include "keytable.h"
+#include "json.h"
+
+// The parsers report what they read through the emit* functions below, they
+// are templated on the receiver so the calls are resolved at compile time.
+// DomBuilder builds a JSONNode tree, EventHandler forwards to a JSONHandler.
+
+struct DomBuilder
+{
+    JSONDocument *document;
+    Arena *arena;
+    ParseScratch *scratch;
+    uint32_t flags;
+
+    // Key of the next value when the current container is an object
+    JSONString key;
+    uint32_t keyHash;
+
+    // Set once the outermost container is closed
+    JSONNode root;
+};
+
+struct EventHandler
+{
+    const JSONHandler *handler;
+    void *userData;
+};
+
+void initDomBuilder(DomBuilder *builder, JSONDocument *document, ParseScratch *scratch, uint32_t flags);
+
+JSONError pushDomFrame(ParseScratch *scratch, JSONNodeType type, JSONString *key, uint32_t keyHash);
+
+// Parses a range of array elements separated by commas, without brackets, as
+// the children of an array opened on the builder. They are left on the node
+// stack of the scratch. endsArray is set for the range right before the
+// closing bracket, which can end with a comma like in parseArrayNode.
+JSONError parseArrayElements(DomBuilder *builder, parseContext *ctx, bool endsArray);
+
+//
+// DomBuilder events
+//
+
+inline JSONError setBuilderString(DomBuilder *builder, JSONString *string, const char *data, size_t length,
+                                  bool inInput)
+{
+    // Decoded escapes live in the scratch buffer and must always be copied
+    if (inInput && (builder->flags & JSON_PARSE_VIEW_STRINGS))
+    {
+        setJSONStringView(string, data, length);
+        return ERR_NOERROR;
+    }
+
+    return setJSONStringData(string, builder->arena, data, length);
+}
+
+inline JSONError addDomValue(DomBuilder *builder, JSONNode *value)
+{
+    ParseScratch *scratch = builder->scratch;
+
+    if (scratch->frameCount == 0)
+    {
+        builder->root = *value;
+        return ERR_NOERROR;
+    }
+
+    bool inObject = scratch->frames[scratch->frameCount - 1].type == OBJECT_NODE;
+
+    return pushToNodeStack(&scratch->stack, inObject ? &builder->key : NULL, builder->keyHash, value);
+}
+
+inline JSONError emitStartContainer(DomBuilder *builder, JSONNodeType type)
+{
+    return pushDomFrame(builder->scratch, type, &builder->key, builder->keyHash);
+}
+
+inline JSONError emitEndContainer(DomBuilder *builder, JSONNodeType type)
+{
+    JSONError error;
+    ParseScratch *scratch = builder->scratch;
+    DomFrame *frame = &scratch->frames[--scratch->frameCount];
+
+    JSONNode node = {};
+    node.type = type;
+
+    if ((error = popFromNodeStack(&scratch->stack, builder->arena, &node, frame->stackStart)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    builder->key = frame->key;
+    builder->keyHash = frame->keyHash;
+
+    return addDomValue(builder, &node);
+}
+
+inline JSONError emitLazyContainer(DomBuilder *builder, const char *begin, size_t length)
+{
+    LazySpan *span = (LazySpan *) arenaAlloc(builder->arena, sizeof(LazySpan));
+    if (!span)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    span->begin = begin;
+    span->length = length;
+    span->document = builder->document;
+    span->flags = builder->flags & ~(uint32_t) JSON_PARSE_STRUCTURAL_INDEX;
+
+    JSONNode node = {};
+    node.type = *begin == '{' ? OBJECT_NODE : ARRAY_NODE;
+    node.lazy = span;
+
+    return addDomValue(builder, &node);
+}
+
+inline JSONError emitKey(DomBuilder *builder, const char *data, size_t length, bool inInput)
+{
+    builder->keyHash = hashKey(data, length);
+
+    // Neither copied nor viewed, the table holds the key for every document
+    JSONKeyTable *keyTable = builder->document->keyTable;
+    if (keyTable)
+    {
+        const JSONString *interned = internKey(keyTable, data, length, builder->keyHash);
+        if (interned)
+        {
+            builder->key = *interned;
+            return ERR_NOERROR;
+        }
+    }
+
+    return setBuilderString(builder, &builder->key, data, length, inInput);
+}
+
+inline JSONError emitString(DomBuilder *builder, const char *data, size_t length, bool inInput)
+{
+    JSONError error;
+
+    JSONNode node = {};
+    node.type = STRING_NODE;
+    node.stringValue = (JSONString *) arenaAlloc(builder->arena, sizeof(JSONString));
+    if (!node.stringValue)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    if ((error = setBuilderString(builder, node.stringValue, data, length, inInput)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    return addDomValue(builder, &node);
+}
+
+inline JSONError emitInteger(DomBuilder *builder, int64_t value)
+{
+    JSONNode node = {};
+    node.type = INTEGER_NODE;
+    node.intValue = value;
+
+    return addDomValue(builder, &node);
+}
+
+inline JSONError emitDouble(DomBuilder *builder, double value)
+{
+    JSONNode node = {};
+    node.type = DOUBLE_NODE;
+    node.doubleValue = value;
+
+    return addDomValue(builder, &node);
+}
+
+inline JSONError emitBoolean(DomBuilder *builder, bool value)
+{
+    JSONNode node = {};
+    node.type = BOOLEAN_NODE;
+    node.booleanValue = value;
+
+    return addDomValue(builder, &node);
+}
+
+inline JSONError emitNull(DomBuilder *builder)
+{
+    JSONNode node = {};
+    node.type = NULL_NODE;
+
+    return addDomValue(builder, &node);
+}
+
+//
+// EventHandler events
+//
+
+inline JSONError emitStartContainer(EventHandler *events, JSONNodeType type)
+{
+    JSONError (*callback)(void *) = type == OBJECT_NODE ? events->handler->startObject : events->handler->startArray;
+
+    return callback ? callback(events->userData) : ERR_NOERROR;
+}
+
+inline JSONError emitEndContainer(EventHandler *events, JSONNodeType type)
+{
+    JSONError (*callback)(void *) = type == OBJECT_NODE ? events->handler->endObject : events->handler->endArray;
+
+    return callback ? callback(events->userData) : ERR_NOERROR;
+}
+
+// NOTE(vincent): never called, the event parsers clear JSON_PARSE_LAZY
+inline JSONError emitLazyContainer(EventHandler *events, const char *begin, size_t length)
+{
+    return ERR_INVALID_ARGUMENT;
+}
+
+inline JSONError emitKey(EventHandler *events, const char *data, size_t length, bool inInput)
+{
+    const JSONHandler *handler = events->handler;
+
+    return handler->key ? handler->key(events->userData, data, length) : ERR_NOERROR;
+}
+
+inline JSONError emitString(EventHandler *events, const char *data, size_t length, bool inInput)
+{
+    const JSONHandler *handler = events->handler;
+
+    return handler->stringValue ? handler->stringValue(events->userData, data, length) : ERR_NOERROR;
+}
+
+inline JSONError emitInteger(EventHandler *events, int64_t value)
+{
+    const JSONHandler *handler = events->handler;
+
+    return handler->intValue ? handler->intValue(events->userData, value) : ERR_NOERROR;
+}
+
+inline JSONError emitDouble(EventHandler *events, double value)
+{
+    const JSONHandler *handler = events->handler;
+
+    return handler->doubleValue ? handler->doubleValue(events->userData, value) : ERR_NOERROR;
+}
+
+inline JSONError emitBoolean(EventHandler *events, bool value)
+{
+    const JSONHandler *handler = events->handler;
+
+    return handler->booleanValue ? handler->booleanValue(events->userData, value) : ERR_NOERROR;
+}
+
+inline JSONError emitNull(EventHandler *events)
+{
+    const JSONHandler *handler = events->handler;
+
+    return handler->nullValue ? handler->nullValue(events->userData) : ERR_NOERROR;
+}
@@ -2,45 +2,73 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "allocator.h"
+#include "arena.h"
 #include "buffer.h"
+#include "events.h"
+#include "json_private.h"
+#include "number.h"
+#include "path.h"
+#include "structural.h"
+#include "tape.h"
+#include "utf8.h"
 #include "json.h"
 
 //
 // JSONString private API
 //
 
-struct JSONString
+// Copies the data in the arena and NUL terminates it
+JSONError setJSONStringData(JSONString *string, Arena *arena, const char *data, size_t length)
 {
-    Buffer *buffer;
-};
+    char *copy = (char *) arenaAlloc(arena, length + 1);
+    if (!copy)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
 
-void initJSONString(JSONString *string)
-{
-    string->buffer = newBuffer();
-}
+    memcpy(copy, data, length);
+    copy[length] = '\0';
 
-JSONString* newJSONString()
-{
-    JSONString *ptr = (JSONString*) malloc(sizeof(JSONString));
-    initJSONString(ptr);
-    return ptr;
-}
+    string->data = copy;
+    string->length = length;
 
-// NOTE(vincent): this does not *free* the string !!
-// It only cleans/frees all fields of the string
-void cleanJSONString(JSONString *string)
-{
-    freeBuffer(string->buffer);
+    return ERR_NOERROR;
 }
 
-JSONError setJSONStringData(JSONString *string, char *buffer, size_t length)
+// NOTE(vincent): a view is not NUL terminated, the data lives in the input
+void setJSONStringView(JSONString *string, const char *data, size_t length)
 {
-    return putArrayToBuffer(string->buffer, buffer, length);
+    string->data = (char *) data;
+    string->length = length;
 }
 
-JSONError setJSONStringData(JSONString *string, Buffer *buffer)
+// Hashes 8 bytes at a time, keys are short so this needs to be cheap more
+// than it needs to be strong.
+uint32_t hashKey(const char *data, size_t length)
 {
-    return copyBuffer(string->buffer, buffer);
+    const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+    uint64_t hash = length * multiplier;
+
+    for (; length >= 8; data += 8, length -= 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+
+    if (length)
+    {
+        uint64_t word = 0;
+        memcpy(&word, data, length);
+
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+
+    return (uint32_t) (hash ^ (hash >> 32));
 }
 
 //
@@ -49,70 +77,123 @@ JSONError setJSONStringData(JSONString *string, Buffer *buffer)
 
 JSON_API char* JSONStringGetData(JSONString *string)
 {
-    return getDataFromBuffer(string->buffer);
+    if (isTapePointer(string))
+    {
+        return getTapeStringData(getTapeWord(string));
+    }
+
+    return string->data;
+}
+
+JSON_API size_t JSONStringGetLength(JSONString *string)
+{
+    if (isTapePointer(string))
+    {
+        return (size_t) getTapePayload(*getTapeWord(string));
+    }
+
+    return string->length;
 }
 
 //
 // JSONStringArray private API
 //
 
-struct JSONStringArray
-{
-    JSONString *underlying;
-    size_t capacity;
-    size_t index;
-};
+// Objects with at least this many keys get a hash table to look them up,
+// smaller ones are scanned linearly comparing the hashes first.
+#define HASHED_OBJECT_MIN_KEYS 16
 
-void freeJSONStringArray(JSONStringArray *array)
+JSONStringArray* newJSONStringArray(Arena *arena, size_t capacity)
 {
-    for (size_t i = 0; i < array->index; i++)
+    JSONStringArray *array = (JSONStringArray *) arenaAlloc(arena, sizeof(JSONStringArray));
+    if (!array)
     {
-        cleanJSONString(&array->underlying[i]);
+        return NULL;
     }
-    free(array->underlying);
-}
 
-JSONStringArray* newJSONStringArray(size_t capacity)
-{
-    JSONStringArray *array = (JSONStringArray *) malloc(sizeof(JSONStringArray));
+    memset(array, 0, sizeof(JSONStringArray));
     array->capacity = capacity;
-    array->underlying = (JSONString *) malloc(sizeof(JSONString) * capacity);
-    memset(array->underlying, 0, sizeof(JSONString) * capacity);
-    array->index = 0;
+    array->underlying = (JSONString *) arenaAlloc(arena, sizeof(JSONString) * capacity);
+    array->hashes = (uint32_t *) arenaAlloc(arena, sizeof(uint32_t) * capacity);
+    if (!array->underlying || !array->hashes)
+    {
+        return NULL;
+    }
 
     return array;
 }
 
-JSONString* newJSONStringFromArray(JSONStringArray *array)
+// Must be called once all the keys are set
+JSONError buildJSONStringArrayTable(JSONStringArray *array, Arena *arena)
 {
-    JSONString *ptr = array->underlying + array->index;
-    array->index++;
+    size_t tableSize = HASHED_OBJECT_MIN_KEYS;
+    while (tableSize < array->index * 2)
+    {
+        tableSize *= 2;
+    }
 
-    initJSONString(ptr);
+    array->table = (uint32_t *) arenaAlloc(arena, sizeof(uint32_t) * tableSize);
+    if (!array->table)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+    memset(array->table, 0, sizeof(uint32_t) * tableSize);
+    array->tableMask = tableSize - 1;
 
-    return ptr;
-}
+    // With duplicate keys the first one is inserted first, and found first
+    for (size_t i = 0; i < array->index; i++)
+    {
+        size_t slot = array->hashes[i] & array->tableMask;
+        while (array->table[slot])
+        {
+            slot = (slot + 1) & array->tableMask;
+        }
 
-//
-// JSONNode API
-//
+        array->table[slot] = (uint32_t) (i + 1);
+    }
 
-struct JSONNode
+    return ERR_NOERROR;
+}
+
+// Returns the index of the first key equal to `key`, or -1
+int64_t findInJSONStringArray(JSONStringArray *array, const char *key, size_t keyLength, uint32_t hash)
 {
-    JSONNodeType type;
+    if (array->table)
+    {
+        for (size_t slot = hash & array->tableMask;; slot = (slot + 1) & array->tableMask)
+        {
+            uint32_t entry = array->table[slot];
+            if (!entry)
+            {
+                return -1;
+            }
 
-    JSONStringArray *keys;
-    JSONNode *values;
-    size_t length;
+            size_t i = entry - 1;
+            JSONString *candidate = &array->underlying[i];
+            if (array->hashes[i] == hash && candidate->length == keyLength
+                    && (candidate->data == key || memcmp(candidate->data, key, keyLength) == 0))
+            {
+                return (int64_t) i;
+            }
+        }
+    }
 
-    union
+    for (size_t i = 0; i < array->index; i++)
     {
-        JSONString *stringValue;
-        bool booleanValue;
-        int64_t intValue;
-        double doubleValue;
-    };
-};
+        JSONString *candidate = &array->underlying[i];
+        if (array->hashes[i] == hash && candidate->length == keyLength
+                && (candidate->data == key || memcmp(candidate->data, key, keyLength) == 0))
+        {
+            return (int64_t) i;
+        }
+    }
+
+    return -1;
+}
+
+//
+// JSONNode API
+//
 
 JSON_API const char* JSONNodeTypeToString(JSONNodeType type)
 {
@@ -130,710 +211,1728 @@ JSON_API const char* JSONNodeTypeToString(JSONNodeType type)
     }
 }
 
-struct parseContext
+void freeNodeStack(NodeStack *stack)
 {
-    const char *input;
-    size_t *index;
-    size_t inputLength;
-};
+    const JSONAllocator *allocator = stack->allocator;
 
-// forward declare because of parseKeyValuePair
-JSONError parseObjectNode(JSONNode *node, parseContext *ctx, bool *parsedSomething);
-JSONError parseArrayNode(JSONNode *node, parseContext *ctx, bool *parsedSomething);
+    freeMemory(allocator, stack->keys);
+    freeMemory(allocator, stack->keyHashes);
+    freeMemory(allocator, stack->values);
+    memset(stack, 0, sizeof(NodeStack));
+    stack->allocator = allocator;
+}
 
-JSONError consumeWhitespaces(parseContext *ctx)
+JSONError growNodeStack(NodeStack *stack)
 {
-    size_t *idx = ctx->index;
+    size_t newCapacity = stack->capacity ? stack->capacity * 2 : 64;
 
-    for (; *idx < ctx->inputLength;)
+    JSONString *keys = (JSONString *) reallocMemory(stack->allocator, stack->keys, sizeof(JSONString) * newCapacity);
+    if (!keys)
     {
-        char ch = ctx->input[*idx];
-        if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r')
-        {
-            return ERR_NOERROR;
-        }
+        return ERR_OUT_OF_MEMORY;
+    }
+    stack->keys = keys;
 
-        (*idx)++;
+    uint32_t *keyHashes = (uint32_t *) reallocMemory(stack->allocator, stack->keyHashes, sizeof(uint32_t) * newCapacity);
+    if (!keyHashes)
+    {
+        return ERR_OUT_OF_MEMORY;
     }
+    stack->keyHashes = keyHashes;
 
-    return ERR_EOF;
-}
+    JSONNode *values = (JSONNode *) reallocMemory(stack->allocator, stack->values, sizeof(JSONNode) * newCapacity);
+    if (!values)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+    stack->values = values;
 
-struct parseStringContext
-{
-    parseContext *globalCtx;
-    Buffer *buffer;
-};
+    stack->capacity = newCapacity;
 
-bool isDigit(char ch)
-{
-    return ch == '0' || ch == '1' || ch == '2'
-        || ch == '3' || ch == '4' || ch == '5'
-        || ch == '6' || ch == '7' || ch == '8'
-        || ch == '9';
+    return ERR_NOERROR;
 }
 
-JSONError readUnicodeEscapedChar(parseStringContext *ctx)
+// key can be NULL for array elements
+JSONError pushToNodeStack(NodeStack *stack, JSONString *key, uint32_t keyHash, JSONNode *value)
 {
     JSONError error;
-    size_t *idx = ctx->globalCtx->index;
 
-    if ((*idx) + 4 >= ctx->globalCtx->inputLength)
+    if (stack->length == stack->capacity)
     {
-        return ERR_EOF;
+        if ((error = growNodeStack(stack)) != ERR_NOERROR)
+        {
+            return error;
+        }
     }
 
-    char buffer[7];
-    buffer[0] = '0';
-    buffer[1] = 'x';
-    for (int i = 2; i < 6; i++, (*idx)++)
+    if (key)
     {
-        buffer[i] = ctx->globalCtx->input[*idx];
+        stack->keys[stack->length] = *key;
+        stack->keyHashes[stack->length] = keyHash;
     }
-    buffer[6] = '\0';
+    stack->values[stack->length] = *value;
+    stack->length++;
+
+    return ERR_NOERROR;
+}
 
-    int32_t s = strtol(buffer, NULL, 16);
+// Moves the entries pushed since `start` to the node
+JSONError popFromNodeStack(NodeStack *stack, Arena *arena, JSONNode *node, size_t start)
+{
+    size_t count = stack->length - start;
 
-    char ch = (char) ((s & 0xFF00) >> 8);
-    char ch2 = (char) (s & 0xFF);
+    node->length = count;
+    stack->length = start;
 
-    if ((error = putCharToBuffer(ctx->buffer, ch)) != ERR_NOERROR)
+    if (count == 0)
     {
-        return error;
+        return ERR_NOERROR;
     }
 
-    if ((error = putCharToBuffer(ctx->buffer, ch2)) != ERR_NOERROR)
+    node->values = (JSONNode *) arenaAlloc(arena, sizeof(JSONNode) * count);
+    if (!node->values)
     {
-        return error;
+        return ERR_OUT_OF_MEMORY;
     }
+    memcpy(node->values, stack->values + start, sizeof(JSONNode) * count);
 
-    return ERR_NOERROR;
-}
-
-JSONError parseString(parseStringContext *ctx)
-{
-    JSONError error;
-    size_t *idx = ctx->globalCtx->index;
-
-    // Prerequisites
+    if (node->type == OBJECT_NODE)
     {
-        if ((*idx + 2) >= ctx->globalCtx->inputLength)
+        node->keys = newJSONStringArray(arena, count);
+        if (!node->keys)
         {
-            return ERR_EOF;
+            return ERR_OUT_OF_MEMORY;
         }
+        memcpy(node->keys->underlying, stack->keys + start, sizeof(JSONString) * count);
+        memcpy(node->keys->hashes, stack->keyHashes + start, sizeof(uint32_t) * count);
+        node->keys->index = count;
 
-        char ch = ctx->globalCtx->input[(*idx)++];
-        if (ch != '"')
+        if (count >= HASHED_OBJECT_MIN_KEYS)
         {
-            return ERR_INVALID_STRING;
+            return buildJSONStringArrayTable(node->keys, arena);
         }
     }
 
-    bool sawBackslash = false;
-
-    for (; *idx < ctx->globalCtx->inputLength; (*idx)++)
-    {
-        char ch = ctx->globalCtx->input[*idx];
-
-        if (ch == '\\' && !sawBackslash)
-        {
-            sawBackslash = true;
-
-            continue;
-        }
-
-        if (ch == '"')
-        {
-            if (!sawBackslash)
-            {
-                // end of string
-                (*idx)++;
-                goto done;
-            }
-
-            sawBackslash = false;
+    return ERR_NOERROR;
+}
 
-            if ((error = putCharToBuffer(ctx->buffer, ch)) != ERR_NOERROR)
-            {
-                return error;
-            }
+void initParseScratch(ParseScratch *scratch, const JSONAllocator *allocator)
+{
+    memset(scratch, 0, sizeof(ParseScratch));
+    scratch->allocator = allocator;
+    scratch->stack.allocator = allocator;
+    scratch->structurals.allocator = allocator;
+}
 
-            continue;
-        }
+void freeParseScratch(ParseScratch *scratch)
+{
+    if (scratch->buffer)
+    {
+        freeBuffer(scratch->buffer);
+    }
+    freeNodeStack(&scratch->stack);
+    freeMemory(scratch->allocator, scratch->frames);
+    freeStructuralIndex(&scratch->structurals);
+    initParseScratch(scratch, scratch->allocator);
+}
 
-        if (sawBackslash && (ch == 'b' || ch == 'f' || ch == 'n' ||
-                             ch == 'r' || ch == 't'))
-        {
-            switch (ch)
-            {
-                case 'b': ch = '\b'; break;
-                case 'f': ch = '\f'; break;
-                case 'n': ch = '\n'; break;
-                case 'r': ch = '\r'; break;
-                case 't': ch = '\t'; break;
-            }
+//
+// DomBuilder API
+//
 
-            if ((error = putCharToBuffer(ctx->buffer, ch)) != ERR_NOERROR)
-            {
-                return error;
-            }
+void initDomBuilder(DomBuilder *builder, JSONDocument *document, ParseScratch *scratch, uint32_t flags)
+{
+    memset(builder, 0, sizeof(DomBuilder));
+    builder->document = document;
+    builder->arena = &document->arena;
+    builder->scratch = scratch;
+    builder->flags = flags;
+
+    // A failed parse can leave entries behind
+    scratch->stack.length = 0;
+    scratch->frameCount = 0;
+}
 
-            sawBackslash = false;
-            continue;
-        }
+JSONError pushDomFrame(ParseScratch *scratch, JSONNodeType type, JSONString *key, uint32_t keyHash)
+{
+    if (scratch->frameCount == scratch->frameCapacity)
+    {
+        size_t newCapacity = scratch->frameCapacity ? scratch->frameCapacity * 2 : 32;
 
-        if (sawBackslash && ch == 'u')
+        DomFrame *frames = (DomFrame *) reallocMemory(scratch->allocator, scratch->frames, sizeof(DomFrame) * newCapacity);
+        if (!frames)
         {
-            (*idx)++; // eat the token
-
-            if ((error = readUnicodeEscapedChar(ctx)) != ERR_NOERROR)
-            {
-                return error;
-            }
-
-            sawBackslash = false;
-            continue;
+            return ERR_OUT_OF_MEMORY;
         }
 
-        if ((error = putCharToBuffer(ctx->buffer, ch)) != ERR_NOERROR)
-        {
-            return error;
-        }
+        scratch->frames = frames;
+        scratch->frameCapacity = newCapacity;
     }
 
-done:
-
-    if ((error = putCharToBuffer(ctx->buffer, '\0')) != ERR_NOERROR)
-    {
-        return error;
-    }
+    DomFrame *frame = &scratch->frames[scratch->frameCount++];
+    frame->type = type;
+    frame->stackStart = scratch->stack.length;
+    frame->key = *key;
+    frame->keyHash = keyHash;
 
     return ERR_NOERROR;
 }
 
-JSONError parseBoolean(parseContext *globalCtx, bool *ret)
-{
-    size_t *idx = globalCtx->index;
-    char ch = globalCtx->input[*idx];
-    size_t toRead = ch == 't' ? 3 : 4;
+//
+// Parser
+//
 
-    if ((*idx + toRead) >= globalCtx->inputLength)
-    {
-        return ERR_EOF;
-    }
+// forward declare because of parseKeyValuePair
+template <typename Handler> JSONError parseObjectNode(Handler *handler, parseContext *ctx);
+template <typename Handler> JSONError parseArrayNode(Handler *handler, parseContext *ctx);
 
-    (*idx)++;
+JSONError consumeWhitespaces(parseContext *ctx)
+{
+    size_t *idx = ctx->index;
 
-    // True case
-    if (ch == 't')
+    for (; *idx < ctx->inputLength;)
     {
-        if (globalCtx->input[(*idx)++] == 'r'
-                && globalCtx->input[(*idx)++] == 'u'
-                && globalCtx->input[(*idx)++] == 'e')
+        char ch = ctx->input[*idx];
+        if (ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r')
         {
-            *ret = true;
             return ERR_NOERROR;
         }
-    }
 
-    // False case
-    if (globalCtx->input[(*idx)++] == 'a'
-            && globalCtx->input[(*idx)++] == 'l'
-            && globalCtx->input[(*idx)++] == 's'
-            && globalCtx->input[(*idx)++] == 'e')
-    {
-        *ret = false;
-        return ERR_NOERROR;
+        (*idx)++;
     }
 
-    return ERR_INVALID_BOOLEAN_SYNTAX;
+    return ERR_EOF;
 }
 
-JSONError parseNumber(parseContext *ctx, JSONNodeType *type, int8_t* bytes)
+struct parseStringContext
+{
+    parseContext *globalCtx;
+    Buffer *buffer;
+};
+
+// Returns the first '"' or '\\' in [ptr, end), or end if there is none. Sets
+// nonASCII if a byte before it is not ASCII, pure ASCII strings then need no
+// UTF-8 validation. Checks 8 bytes at a time, strings without escapes are the
+// common case.
+const char* findQuoteOrBackslash(const char *ptr, const char *end, bool *nonASCII)
 {
-    size_t *idx = ctx->index;
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highBits = 0x8080808080808080ULL;
+    const uint64_t quotes = ones * '"';
+    const uint64_t backslashes = ones * '\\';
+    uint64_t seen = 0;
 
-    char buffer[1 << 16];
-    bool isDouble = false;
-    int i = 0;
-    for (; *idx < ctx->inputLength; i++, (*idx)++)
+    for (; ptr + 8 <= end; ptr += 8)
     {
-        char ch = ctx->input[*idx];
-        if (ch == '.')
-        {
-            isDouble = true;
-            buffer[i] = ch;
-            continue;
-        }
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
 
-        if (!isDigit(ch) && ch != '-')
+        uint64_t q = word ^ quotes;
+        uint64_t b = word ^ backslashes;
+        if ((((q - ones) & ~q) | ((b - ones) & ~b)) & highBits)
         {
             break;
         }
 
-        buffer[i] = ch;
+        seen |= word;
     }
-    buffer[i] = '\0';
 
-    if (isDouble)
+    for (; ptr < end; ptr++)
     {
-        *type = DOUBLE_NODE;
-        *((double*) bytes) = atof(buffer);
+        if (*ptr == '"' || *ptr == '\\')
+        {
+            break;
+        }
+
+        seen |= (uint8_t) *ptr;
     }
-    else
+
+    if (seen & highBits)
     {
-        *type = INTEGER_NODE;
-        *((int64_t*) bytes) = _atoi64(buffer);
+        *nonASCII = true;
     }
 
-    return ERR_NOERROR;
+    return ptr;
 }
 
-JSONError parseValue(JSONNode *value, parseContext *ctx, bool *parsedSomething)
+// Decodes the 4 hex digits after \u at *ptr, with the low surrogate escape
+// following a high one. Lone surrogates have no UTF-8 encoding and are rejected.
+JSONError readUnicodeEscapedChar(parseStringContext *ctx, const char **ptr, const char *end)
 {
-    JSONError error = ERR_NOERROR;
-    size_t *idx = ctx->index;
+    uint32_t codePoint;
 
-    char ch = ctx->input[*idx]; // do not eat the character
-
-    if (ch == '{')
+    if (end - *ptr < 4)
     {
-        (*idx)++; // eat the token
-
-        return parseObjectNode(value, ctx, parsedSomething);
+        return ERR_EOF;
     }
 
-    if (ch == '[')
+    if (!decodeHex4(*ptr, &codePoint))
     {
-        (*idx)++; // eat the token
-
-        return parseArrayNode(value, ctx, parsedSomething);
+        return ERR_INVALID_UNICODE_LITERAL_SYNTAX;
     }
+    *ptr += 4;
 
-    if (ch == '"')
+    if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
     {
-        parseStringContext valCtx = {};
-        valCtx.globalCtx = ctx;
-        valCtx.buffer = newBuffer();
+        uint32_t lowSurrogate;
 
-        if ((error = parseString(&valCtx)) != ERR_NOERROR)
+        if (end - *ptr >= 2 && ((*ptr)[0] != '\\' || (*ptr)[1] != 'u'))
         {
-            return error;
+            return ERR_INVALID_UNICODE_LITERAL_SYNTAX;
         }
 
-        value->type = STRING_NODE;
-        value->stringValue = newJSONString();
-        setJSONStringData(value->stringValue, valCtx.buffer);
-
-        freeBuffer(valCtx.buffer);
+        if (end - *ptr < 6)
+        {
+            return ERR_EOF;
+        }
 
-        if (parsedSomething)
+        if (!decodeHex4(*ptr + 2, &lowSurrogate) || lowSurrogate < 0xDC00 || lowSurrogate > 0xDFFF)
         {
-            *parsedSomething = true;
+            return ERR_INVALID_UNICODE_LITERAL_SYNTAX;
         }
+        *ptr += 6;
 
-        return error;
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
     }
-
-    if (ch == 't' || ch == 'f')
+    else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
     {
-        bool ret;
-        if ((error = parseBoolean(ctx, &ret)) != ERR_NOERROR)
-        {
-            return error;
-        }
+        return ERR_INVALID_UNICODE_LITERAL_SYNTAX;
+    }
 
-        value->type = BOOLEAN_NODE;
-        value->booleanValue = ret;
+    char encoded[4];
+    size_t encodedLength = encodeUTF8(codePoint, encoded);
 
-        if (parsedSomething)
-        {
-            *parsedSomething = true;
-        }
+    return putArrayToBuffer(ctx->buffer, encoded, encodedLength);
+}
 
-        return error;
-    }
+// Decodes the string at the current index in the buffer and NUL terminates it.
+// The raw bytes between escapes are copied a run at a time and validated as
+// UTF-8, decoded escapes always are.
+JSONError parseString(parseStringContext *ctx)
+{
+    JSONError error;
+    size_t *idx = ctx->globalCtx->index;
+    const char *input = ctx->globalCtx->input;
+    const char *end = input + ctx->globalCtx->inputLength;
 
-    if (ch == 'n')
+    // The opening quote was checked by readJSONString
+    const char *ptr = input + *idx + 1;
+
+    for (;;)
     {
-        (*idx)++; // eat the token
+        const char *run = ptr;
+        bool nonASCII = false;
 
-        if ((*idx) + 3 >= ctx->inputLength)
+        ptr = findQuoteOrBackslash(ptr, end, &nonASCII);
+        if (ptr == end)
         {
             return ERR_EOF;
         }
 
-        char ch1 = ctx->input[(*idx)++];
-        char ch2 = ctx->input[(*idx)++];
-        char ch3 = ctx->input[(*idx)++];
-
-        if (ch1 != 'u' && ch2 != 'l' && ch3 != 'l')
+        if (nonASCII && !isValidUTF8(run, (size_t) (ptr - run)))
         {
-            return ERR_INVALID_NULL_SYNTAX;
+            return ERR_INVALID_UTF8;
         }
 
-        value->type = NULL_NODE;
-
-        if (parsedSomething)
+        if ((error = putArrayToBuffer(ctx->buffer, run, (size_t) (ptr - run))) != ERR_NOERROR)
         {
-            *parsedSomething = true;
+            return error;
         }
 
-        return error;
-    }
-
-    if (isDigit(ch) || ch == '-')
-    {
-        int8_t bytes[8];
-
-        if ((error = parseNumber(ctx, &value->type, (int8_t*) bytes)) != ERR_NOERROR)
+        if (*ptr++ == '"')
         {
-            return error;
+            break;
         }
 
-        if (value->type == DOUBLE_NODE)
+        if (ptr == end)
         {
-            value->doubleValue = *((double*) bytes);
+            return ERR_EOF;
         }
-        else
+
+        char ch = *ptr++;
+        switch (ch)
         {
-            value->intValue = *((int64_t*) bytes);
+            case '"':
+            case '\\':
+            case '/':
+                break;
+            case 'b': ch = '\b'; break;
+            case 'f': ch = '\f'; break;
+            case 'n': ch = '\n'; break;
+            case 'r': ch = '\r'; break;
+            case 't': ch = '\t'; break;
+            case 'u':
+            {
+                if ((error = readUnicodeEscapedChar(ctx, &ptr, end)) != ERR_NOERROR)
+                {
+                    return error;
+                }
+
+                continue;
+            }
+            default:
+            {
+                return ERR_INVALID_STRING;
+            }
         }
 
-        if (parsedSomething)
+        if ((error = putCharToBuffer(ctx->buffer, ch)) != ERR_NOERROR)
         {
-            *parsedSomething = true;
+            return error;
         }
     }
 
-    return error;
+    *idx = (size_t) (ptr - input);
+
+    return putCharToBuffer(ctx->buffer, '\0');
 }
 
-JSONError parseKeyValuePair(JSONString *key, JSONNode *value, parseContext *ctx, bool *parsedSomething)
+JSONError readJSONString(parseContext *ctx, const char **data, size_t *length, bool *inInput)
 {
     JSONError error;
     size_t *idx = ctx->index;
 
+    if ((*idx + 1) >= ctx->inputLength)
     {
-        parseStringContext keyCtx = {};
-        keyCtx.buffer = newBuffer();
-        keyCtx.globalCtx = ctx;
-        if ((error = parseString(&keyCtx)) != ERR_NOERROR)
-        {
-            return error;
-        }
-
-        setJSONStringData(key, keyCtx.buffer);
+        return ERR_EOF;
+    }
 
-        freeBuffer(keyCtx.buffer);
+    if (ctx->input[*idx] != '"')
+    {
+        return ERR_INVALID_STRING;
     }
 
-    // Prerequisites
+    const char *start = ctx->input + *idx + 1;
+    const char *end = ctx->input + ctx->inputLength;
+    bool nonASCII = false;
+    const char *ptr = findQuoteOrBackslash(start, end, &nonASCII);
+
+    if (ptr == end)
     {
-        if ((*idx + 1) >= ctx->inputLength)
-        {
-            return ERR_EOF;
-        }
+        return ERR_EOF;
+    }
 
-        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+    // Strings without escapes are the common case, they need no decoding
+    if (*ptr == '"')
+    {
+        if (nonASCII && !isValidUTF8(start, (size_t) (ptr - start)))
         {
-            return error;
+            return ERR_INVALID_UTF8;
         }
 
-        char ch = ctx->input[(*idx)++];
-        if (ch != ':')
-        {
-            return ERR_INVALID_OBJECT_SYNTAX;
-        }
+        *data = start;
+        *length = (size_t) (ptr - start);
+        *inInput = true;
+        *idx += *length + 2;
 
-        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
-        {
-            return error;
-        }
+        return ERR_NOERROR;
     }
 
+    if (!ctx->scratch->buffer)
     {
-        if ((error = parseValue(value, ctx, parsedSomething)) != ERR_NOERROR)
+        ctx->scratch->buffer = newBuffer(ctx->scratch->allocator);
+        if (!ctx->scratch->buffer)
         {
-            return error;
+            return ERR_OUT_OF_MEMORY;
         }
     }
 
-    if (parsedSomething)
+    parseStringContext stringCtx = {};
+    stringCtx.globalCtx = ctx;
+    stringCtx.buffer = ctx->scratch->buffer;
+    clearBuffer(stringCtx.buffer);
+
+    if ((error = parseString(&stringCtx)) != ERR_NOERROR)
     {
-        *parsedSomething = true;
+        return error;
     }
 
+    // parseString NUL terminates the buffer
+    *data = stringCtx.buffer->underlying;
+    *length = stringCtx.buffer->index - 1;
+    *inInput = false;
+
     return ERR_NOERROR;
 }
 
-JSONError parseObjectNode(JSONNode *node, parseContext *ctx, bool *parsedSomething)
+JSONError parseBoolean(parseContext *globalCtx, bool *ret)
 {
-    JSONError error = ERR_NOERROR;
+    size_t *idx = globalCtx->index;
+    char ch = globalCtx->input[*idx];
+    size_t toRead = ch == 't' ? 3 : 4;
 
-    node->type = OBJECT_NODE;
-    node->keys = newJSONStringArray(2048);
-    node->values = (JSONNode*) malloc(sizeof(JSONNode) * MAX_VALUES); // TODO make this dynamic
-	memset(node->values, 0, sizeof(JSONNode) * MAX_VALUES);
-    size_t *idx = ctx->index;
+    if ((*idx + toRead) >= globalCtx->inputLength)
+    {
+        return ERR_EOF;
+    }
 
-    size_t keyValuePairIdx = 0;
-    for (; *idx < ctx->inputLength;)
+    (*idx)++;
+
+    // True case
+    if (ch == 't')
     {
-        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        if (globalCtx->input[(*idx)++] == 'r'
+                && globalCtx->input[(*idx)++] == 'u'
+                && globalCtx->input[(*idx)++] == 'e')
         {
-            goto done;
+            *ret = true;
+            return ERR_NOERROR;
         }
+    }
 
-        // check early for end of object
-        if (ctx->input[*idx] == '}')
-        {
-            (*idx)++;
+    // False case
+    if (globalCtx->input[(*idx)++] == 'a'
+            && globalCtx->input[(*idx)++] == 'l'
+            && globalCtx->input[(*idx)++] == 's'
+            && globalCtx->input[(*idx)++] == 'e')
+    {
+        *ret = false;
+        return ERR_NOERROR;
+    }
 
-            return consumeWhitespaces(ctx);
-        }
+    return ERR_INVALID_BOOLEAN_SYNTAX;
+}
 
-        {
-            JSONString *key = newJSONStringFromArray(node->keys);
+template <typename Handler>
+JSONError parseNumber(Handler *handler, parseContext *ctx)
+{
+    JSONError error;
+    size_t *idx = ctx->index;
 
-            if ((error = parseKeyValuePair(key, &node->values[keyValuePairIdx], ctx, parsedSomething)) != ERR_NOERROR)
-            {
-                goto done;
-            }
+    const char *start = ctx->input + *idx;
+    const char *end;
 
-            if (parsedSomething && *parsedSomething)
-            {
-                node->length++;
-            }
-        }
+    JSONNodeType type;
+    int64_t intValue = 0;
+    double doubleValue = 0.0;
 
-        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
-        {
-            goto done;
-        }
+    if ((error = parseNumberToken(start, ctx->input + ctx->inputLength, &end,
+                                  &type, &intValue, &doubleValue)) != ERR_NOERROR)
+    {
+        return error;
+    }
 
-        {
-            // parseKeyValuePair advances idx already
-            char ch = ctx->input[*idx];
+    *idx += (size_t) (end - start);
 
-            // end of object
-            if (ch == '}')
-            {
-                (*idx)++; // eat the token
+    STATS_COUNT_NODE(ctx, type);
 
-                return consumeWhitespaces(ctx);
-            }
+    if (type == DOUBLE_NODE)
+    {
+        return emitDouble(handler, doubleValue);
+    }
 
-            ch = ctx->input[*idx];
-            if (ch == ',')
-            {
-                (*idx)++;
+    return emitInteger(handler, intValue);
+}
 
-                keyValuePairIdx++;
-            }
+// Returns the first '"', '{', '}', '[' or ']' in [ptr, end), or end
+const char* findBracketOrQuote(const char *ptr, const char *end)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highBits = 0x8080808080808080ULL;
+
+    for (; ptr + 8 <= end; ptr += 8)
+    {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
+
+        // '{' and '[' (and '}' and ']') only differ by 0x20
+        uint64_t lowered = word | (ones * 0x20);
+        uint64_t opening = lowered ^ (ones * '{');
+        uint64_t closing = lowered ^ (ones * '}');
+        uint64_t quote = word ^ (ones * '"');
+        if ((((opening - ones) & ~opening) | ((closing - ones) & ~closing) | ((quote - ones) & ~quote)) & highBits)
+        {
+            break;
         }
     }
 
-done:
+    for (; ptr < end; ptr++)
+    {
+        char ch = *ptr;
+        if (ch == '"' || ch == '{' || ch == '}' || ch == '[' || ch == ']')
+        {
+            return ptr;
+        }
+    }
 
-    return error;
+    return end;
 }
 
-JSONError parseArrayNode(JSONNode *node, parseContext *ctx, bool *parsedSomething)
+// Returns the quote closing the string whose content starts at ptr, jumping
+// over escaped characters, or end
+const char* findClosingQuote(const char *ptr, const char *end)
 {
-    JSONError error = ERR_NOERROR;
+    bool nonASCII;
 
-    node->type = ARRAY_NODE;
-    node->values = (JSONNode*) malloc(sizeof(JSONNode) * MAX_VALUES); // TODO make this dynamic
-    memset(node->values, 0, sizeof(JSONNode) * MAX_VALUES);
+    for (;; ptr += 2)
+    {
+        ptr = findQuoteOrBackslash(ptr, end, &nonASCII);
+        if (ptr >= end)
+        {
+            return end;
+        }
 
-    size_t *idx = ctx->index;
-    size_t elementIndex = 0;
+        if (*ptr == '"')
+        {
+            return ptr;
+        }
+    }
+}
 
-    for (; *idx < ctx->inputLength;)
+// Finds the end of the container opening at the current index without parsing
+// it, only brackets outside of strings are counted. end is set right after the
+// closing bracket.
+JSONError skipContainer(parseContext *ctx, size_t *end)
+{
+    size_t depth = 0;
+
+    // Containers are skipped by scanning when the index cannot be built, it
+    // only makes finding their end faster
+    if (ctx->structurals && !ctx->structuralsBuilt)
     {
-        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        STATS_TIMER(indexStart);
+
+        if (buildStructuralIndex(ctx->structurals, ctx->input, ctx->inputLength) != ERR_NOERROR)
         {
-            return error;
+            ctx->structurals = NULL;
         }
 
-        JSONNode *element = &node->values[elementIndex];
+        ctx->structuralsBuilt = true;
+        ctx->nextStructural = 0;
+
+        STATS_ADD_ELAPSED(ctx->scratch->stats, indexNanoseconds, indexStart);
+    }
 
-        if ((error = parseValue(element, ctx, parsedSomething)) != ERR_NOERROR)
+    if (ctx->structurals)
+    {
+        const uint32_t *positions = ctx->structurals->positions;
+        size_t i = ctx->nextStructural;
+        while (positions[i] < *ctx->index)
         {
-            return error;
+            i++;
         }
 
-        if (parsedSomething && *parsedSomething)
+        for (; positions[i] < ctx->inputLength; i++)
         {
-            node->length++;
+            char ch = ctx->input[positions[i]];
+            if (ch == '{' || ch == '[')
+            {
+                depth++;
+            }
+            else if ((ch == '}' || ch == ']') && --depth == 0)
+            {
+                ctx->nextStructural = i + 1;
+                *end = positions[i] + 1;
+                return ERR_NOERROR;
+            }
         }
 
-        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        return ERR_EOF;
+    }
+
+    const char *inputEnd = ctx->input + ctx->inputLength;
+    const char *ptr = ctx->input + *ctx->index;
+
+    for (; (ptr = findBracketOrQuote(ptr, inputEnd)) < inputEnd; ptr++)
+    {
+        char ch = *ptr;
+
+        if (ch == '"')
         {
-            return error;
+            // The content is validated once the container is materialized
+            ptr = findClosingQuote(ptr + 1, inputEnd);
+            if (ptr == inputEnd)
+            {
+                return ERR_EOF;
+            }
         }
-
-        char ch = ctx->input[*idx];
-        if (ch == ',')
+        else if (ch == '{' || ch == '[')
         {
-            (*idx)++; // eat the token
-             elementIndex++;
-             continue;
+            depth++;
         }
-
-        if (ch == ']')
+        else if (--depth == 0)
         {
-            (*idx)++; // eat the token
-            error = consumeWhitespaces(ctx);
-            break;
+            *end = (size_t) (ptr - ctx->input) + 1;
+            return ERR_NOERROR;
         }
-
-        return ERR_INVALID_ARRAY_SYNTAX;
     }
 
-    return error;
+    return ERR_EOF;
 }
 
-JSON_API JSONNodeType JSONGetNodeType(JSONNode *node)
+// Moves past the value at the current index without parsing it, for the
+// values left out by a projection. Only its end is looked for, it is not
+// validated.
+JSONError skipValue(parseContext *ctx)
 {
-    if (!node)
+    JSONError error;
+    size_t *idx = ctx->index;
+    char ch = ctx->input[*idx];
+
+    if (ch == '{' || ch == '[')
     {
-        return JSONNodeType::UNKNOWN;
+        size_t end;
+        if ((error = skipContainer(ctx, &end)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        *idx = end;
+        return ERR_NOERROR;
     }
 
-    return node->type;
-}
+    if (ch == '"')
+    {
+        const char *end = ctx->input + ctx->inputLength;
+        const char *quote = findClosingQuote(ctx->input + *idx + 1, end);
+        if (quote == end)
+        {
+            return ERR_EOF;
+        }
 
-JSON_API JSONString* JSONNodeGetString(JSONNode *node)
-{
-    if (!node || node->type != STRING_NODE)
+        *idx = (size_t) (quote - ctx->input) + 1;
+        return ERR_NOERROR;
+    }
+
+    // Numbers and literals end at the next separator
+    for (; *idx < ctx->inputLength; (*idx)++)
     {
-        return NULL;
+        ch = ctx->input[*idx];
+        if (ch == ',' || ch == '}' || ch == ']' || ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
+        {
+            break;
+        }
     }
 
-    return node->stringValue;
+    return ERR_NOERROR;
 }
 
-JSON_API bool JSONNodeGetBool(JSONNode *node)
+// Whether the value at the current index, matched by the paths of mask, is
+// part of the projection: either a path ends there or it goes on inside it
+bool keepsProjectedValue(parseContext *ctx, uint64_t mask)
 {
-    if (!node || node->type != BOOLEAN_NODE)
+    if (!mask)
     {
         return false;
     }
 
-    return node->booleanValue;
-}
-
-JSON_API int64_t JSONNodeGetInteger(JSONNode *node)
-{
-    if (!node || node->type != INTEGER_NODE)
+    if (endsProjection(ctx->projection, mask, ctx->projectionDepth))
     {
-        return -1;
+        return true;
     }
 
-    return node->intValue;
+    char ch = ctx->input[*ctx->index];
+
+    return ch == '{' || ch == '[';
 }
 
-JSON_API double JSONNodeGetDouble(JSONNode *node)
+// Records the extent of the container without building its children, they
+// are parsed the first time the node is iterated or looked up.
+template <typename Handler>
+JSONError parseLazyNode(Handler *handler, parseContext *ctx)
 {
-    if (!node || node->type != DOUBLE_NODE)
+    JSONError error;
+    size_t *idx = ctx->index;
+    size_t end;
+
+    if ((error = skipContainer(ctx, &end)) != ERR_NOERROR)
     {
-        return NAN;
+        return error;
     }
 
-    return node->doubleValue;
-}
+    const char *begin = ctx->input + *idx;
+    *idx = end;
 
-JSON_API JSONNode* JSONCreateNode(void)
-{
-    JSONNode *node = (JSONNode *) malloc(sizeof(JSONNode));
-    memset(node, 0, sizeof(JSONNode));
+    STATS_COUNT_NODE(ctx, *begin == '{' ? OBJECT_NODE : ARRAY_NODE);
 
-    return node;
+    return emitLazyContainer(handler, begin, (size_t) (ctx->input + end - begin));
 }
 
-JSON_API void JSONFreeNode(JSONNode *node)
+template <typename Handler>
+JSONError parseValue(Handler *handler, parseContext *ctx)
 {
-    if (!node)
-    {
-        return;
-    }
+    JSONError error = ERR_NOERROR;
+    size_t *idx = ctx->index;
+
+    char ch = ctx->input[*idx]; // do not eat the character
 
-    if (node->keys)
+    // The root container is always parsed, everything below it is deferred
+    if ((ch == '{' || ch == '[') && (ctx->flags & JSON_PARSE_LAZY))
     {
-        freeJSONStringArray(node->keys);
+        return parseLazyNode(handler, ctx);
     }
 
-    for (size_t i = 0; i < node->length; i++)
+    if (ch == '{')
+    {
+        (*idx)++; // eat the token
+
+        return parseObjectNode(handler, ctx);
+    }
+
+    if (ch == '[')
+    {
+        (*idx)++; // eat the token
+
+        return parseArrayNode(handler, ctx);
+    }
+
+    if (ch == '"')
+    {
+        const char *data;
+        size_t length;
+        bool inInput;
+
+        if ((error = readJSONString(ctx, &data, &length, &inInput)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        STATS_COUNT_NODE(ctx, STRING_NODE);
+        STATS_COUNT_STRING(ctx, length, inInput);
+
+        return emitString(handler, data, length, inInput);
+    }
+
+    if (ch == 't' || ch == 'f')
+    {
+        bool ret;
+        if ((error = parseBoolean(ctx, &ret)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        STATS_COUNT_NODE(ctx, BOOLEAN_NODE);
+
+        return emitBoolean(handler, ret);
+    }
+
+    if (ch == 'n')
+    {
+        (*idx)++; // eat the token
+
+        if ((*idx) + 3 > ctx->inputLength)
+        {
+            return ERR_EOF;
+        }
+
+        char ch1 = ctx->input[(*idx)++];
+        char ch2 = ctx->input[(*idx)++];
+        char ch3 = ctx->input[(*idx)++];
+
+        if (ch1 != 'u' || ch2 != 'l' || ch3 != 'l')
+        {
+            return ERR_INVALID_NULL_SYNTAX;
+        }
+
+        STATS_COUNT_NODE(ctx, NULL_NODE);
+
+        return emitNull(handler);
+    }
+
+    if (isDigit(ch) || ch == '-')
+    {
+        return parseNumber(handler, ctx);
+    }
+
+    return ERR_INVALID_TREE_SYNTAX;
+}
+
+// Parses a kept value of a projected container, matched by the paths of mask
+template <typename Handler>
+JSONError parseProjectedValue(Handler *handler, parseContext *ctx, uint64_t mask)
+{
+    JSONError error;
+    uint64_t parentMask = ctx->projectionMask;
+
+    // A path ends here, the value is kept whole
+    if (endsProjection(ctx->projection, mask, ctx->projectionDepth))
+    {
+        ctx->projectionMask = 0;
+        error = parseValue(handler, ctx);
+        ctx->projectionMask = parentMask;
+
+        return error;
+    }
+
+    // The paths go on inside the container. It is never lazy, they would be
+    // lost by the time it is materialized.
+    char ch = ctx->input[(*ctx->index)++];
+
+    ctx->projectionMask = mask;
+    ctx->projectionDepth++;
+
+    error = ch == '{' ? parseObjectNode(handler, ctx) : parseArrayNode(handler, ctx);
+
+    ctx->projectionDepth--;
+    ctx->projectionMask = parentMask;
+
+    return error;
+}
+
+// Elements left out by a projection are replaced by null, the indices of the
+// others stay the same
+template <typename Handler>
+JSONError parseProjectedElement(Handler *handler, parseContext *ctx, size_t index)
+{
+    JSONError error;
+
+    uint64_t mask = matchProjection(ctx->projection, ctx->projectionMask, ctx->projectionDepth, NULL, 0, index);
+    if (keepsProjectedValue(ctx, mask))
+    {
+        return parseProjectedValue(handler, ctx, mask);
+    }
+
+    if ((error = skipValue(ctx)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    return emitNull(handler);
+}
+
+template <typename Handler>
+JSONError parseKeyValuePair(Handler *handler, parseContext *ctx)
+{
+    JSONError error;
+    size_t *idx = ctx->index;
+
+    const char *key;
+    size_t keyLength;
+    bool inInput;
+
+    if ((error = readJSONString(ctx, &key, &keyLength, &inInput)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    // Prerequisites
+    {
+        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        char ch = ctx->input[(*idx)++];
+        if (ch != ':')
+        {
+            return ERR_INVALID_OBJECT_SYNTAX;
+        }
+
+        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    // Members left out by a projection are not reported at all. The key is
+    // still valid, skipping does not decode strings.
+    uint64_t mask = 0;
+    if (ctx->projectionMask)
+    {
+        mask = matchProjection(ctx->projection, ctx->projectionMask, ctx->projectionDepth, key, keyLength,
+                               PATH_NO_INDEX);
+        if (!keepsProjectedValue(ctx, mask))
+        {
+            return skipValue(ctx);
+        }
+    }
+
+    STATS_COUNT_STRING(ctx, keyLength, inInput);
+
+    if ((error = emitKey(handler, key, keyLength, inInput)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    return mask ? parseProjectedValue(handler, ctx, mask) : parseValue(handler, ctx);
+}
+
+// Called after the opening bracket. Returns right after the closing one, the
+// caller checks what follows.
+template <typename Handler>
+JSONError parseObjectNode(Handler *handler, parseContext *ctx)
+{
+    JSONError error;
+    size_t *idx = ctx->index;
+
+    if ((error = emitStartContainer(handler, OBJECT_NODE)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    STATS_COUNT_NODE(ctx, OBJECT_NODE);
+    STATS_ENTER_CONTAINER(ctx);
+
+    for (;;)
+    {
+        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        // check early for end of object
+        if (ctx->input[*idx] == '}')
+        {
+            (*idx)++;
+            STATS_LEAVE_CONTAINER(ctx);
+
+            return emitEndContainer(handler, OBJECT_NODE);
+        }
+
+        if ((error = parseKeyValuePair(handler, ctx)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        {
+            // parseKeyValuePair advances idx already
+            char ch = ctx->input[*idx];
+
+            // end of object
+            if (ch == '}')
+            {
+                (*idx)++; // eat the token
+                STATS_LEAVE_CONTAINER(ctx);
+
+                return emitEndContainer(handler, OBJECT_NODE);
+            }
+
+            if (ch == ',')
+            {
+                (*idx)++;
+            }
+        }
+    }
+}
+
+template <typename Handler>
+JSONError parseArrayNode(Handler *handler, parseContext *ctx)
+{
+    JSONError error;
+    size_t *idx = ctx->index;
+
+    if ((error = emitStartContainer(handler, ARRAY_NODE)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    STATS_COUNT_NODE(ctx, ARRAY_NODE);
+    STATS_ENTER_CONTAINER(ctx);
+
+    for (size_t elementIndex = 0;; elementIndex++)
+    {
+        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        // empty array, or a trailing comma
+        if (ctx->input[*idx] != ']')
+        {
+            if (ctx->projectionMask)
+            {
+                error = parseProjectedElement(handler, ctx, elementIndex);
+            }
+            else
+            {
+                error = parseValue(handler, ctx);
+            }
+
+            if (error != ERR_NOERROR)
+            {
+                return error == ERR_INVALID_TREE_SYNTAX ? ERR_INVALID_ARRAY_SYNTAX : error;
+            }
+
+            if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+            {
+                return error;
+            }
+        }
+
+        char ch = ctx->input[*idx];
+        if (ch == ',')
+        {
+            (*idx)++; // eat the token
+            continue;
+        }
+
+        if (ch == ']')
+        {
+            (*idx)++; // eat the token
+            STATS_LEAVE_CONTAINER(ctx);
+
+            return emitEndContainer(handler, ARRAY_NODE);
+        }
+
+        return ERR_INVALID_ARRAY_SYNTAX;
+    }
+}
+
+JSONError parseArrayElements(DomBuilder *builder, parseContext *ctx, bool endsArray)
+{
+    JSONError error;
+    size_t *idx = ctx->index;
+
+    if ((error = emitStartContainer(builder, ARRAY_NODE)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    for (;;)
+    {
+        if ((error = consumeWhitespaces(ctx)) != ERR_NOERROR)
+        {
+            // Only ever after a comma, the first range does not end the array
+            if (error == ERR_EOF && endsArray)
+            {
+                return ERR_NOERROR;
+            }
+
+            return error == ERR_EOF ? ERR_INVALID_ARRAY_SYNTAX : error;
+        }
+
+        if ((error = parseValue(builder, ctx)) != ERR_NOERROR)
+        {
+            return error == ERR_INVALID_TREE_SYNTAX ? ERR_INVALID_ARRAY_SYNTAX : error;
+        }
+
+        // The range ends right before a comma or the closing bracket
+        if (consumeWhitespaces(ctx) == ERR_EOF)
+        {
+            return ERR_NOERROR;
+        }
+
+        if (ctx->input[(*idx)++] != ',')
+        {
+            return ERR_INVALID_ARRAY_SYNTAX;
+        }
+    }
+}
+
+// Parses a whole input made of one object or array, surrounded by whitespace
+template <typename Handler>
+JSONError parseInput(Handler *handler, parseContext *ctx)
+{
+    JSONError error;
+    size_t *idx = ctx->index;
+
+    // Built by skipContainer, only when there is a container to skip.
+    // Positions are 32 bits, bigger inputs are skipped without the index.
+    if ((ctx->flags & JSON_PARSE_STRUCTURAL_INDEX) && ctx->inputLength < UINT32_MAX)
+    {
+        ctx->structurals = &ctx->scratch->structurals;
+        ctx->structuralsBuilt = false;
+    }
+
+    if (ctx->projection)
+    {
+        ctx->projectionMask = ctx->projection->rootMask;
+        ctx->projectionDepth = 0;
+    }
+
+    switch (ctx->input[(*idx)++])
+    {
+        case '{':
+        {
+            error = parseObjectNode(handler, ctx);
+            break;
+        }
+        case '[':
+        {
+            error = parseArrayNode(handler, ctx);
+            break;
+        }
+        default:
+        {
+            error = ERR_INVALID_TREE_SYNTAX;
+            break;
+        }
+    }
+
+    // Only whitespace may follow the root
+    if (error == ERR_NOERROR)
+    {
+        error = consumeWhitespaces(ctx) == ERR_EOF ? ERR_NOERROR : ERR_INVALID_TREE_SYNTAX;
+    }
+
+    ctx->structurals = NULL;
+
+    return error;
+}
+
+JSON_API JSONNodeType JSONGetNodeType(JSONNode *node)
+{
+    if (!node)
+    {
+        return JSONNodeType::UNKNOWN;
+    }
+
+    if (isTapePointer(node))
+    {
+        return getTapeNodeType(getTapeWord(node));
+    }
+
+    return node->type;
+}
+
+JSON_API JSONString* JSONNodeGetString(JSONNode *node)
+{
+    if (JSONGetNodeType(node) != STRING_NODE)
+    {
+        return NULL;
+    }
+
+    // The string word is the node word, only the type of the pointer changes
+    if (isTapePointer(node))
+    {
+        return makeTapeString(getTapeWord(node));
+    }
+
+    return node->stringValue;
+}
+
+JSON_API bool JSONNodeGetBool(JSONNode *node)
+{
+    if (JSONGetNodeType(node) != BOOLEAN_NODE)
+    {
+        return false;
+    }
+
+    if (isTapePointer(node))
+    {
+        return getTapeTag(*getTapeWord(node)) == TAPE_TRUE;
+    }
+
+    return node->booleanValue;
+}
+
+JSON_API int64_t JSONNodeGetInteger(JSONNode *node)
+{
+    if (JSONGetNodeType(node) != INTEGER_NODE)
+    {
+        return -1;
+    }
+
+    if (isTapePointer(node))
+    {
+        int64_t value;
+        memcpy(&value, getTapeWord(node) + 1, sizeof(value));
+        return value;
+    }
+
+    return node->intValue;
+}
+
+JSON_API double JSONNodeGetDouble(JSONNode *node)
+{
+    if (JSONGetNodeType(node) != DOUBLE_NODE)
+    {
+        return NAN;
+    }
+
+    if (isTapePointer(node))
+    {
+        double value;
+        memcpy(&value, getTapeWord(node) + 1, sizeof(value));
+        return value;
+    }
+
+    return node->doubleValue;
+}
+
+//
+// JSONDocument API
+//
+
+// Parses the children of a lazy container, its own nested containers stay lazy
+JSONError materializeNode(JSONNode *node)
+{
+    JSONError error;
+    LazySpan *span = node->lazy;
+    size_t index = 1; // after the opening bracket
+
+    parseContext ctx = {};
+    ctx.input = span->begin;
+    ctx.inputLength = span->length;
+    ctx.index = &index;
+    ctx.scratch = &span->document->lazyScratch;
+    ctx.flags = span->flags;
+
+    DomBuilder builder;
+    initDomBuilder(&builder, span->document, ctx.scratch, span->flags);
+
+    if (node->type == OBJECT_NODE)
     {
-        JSONFreeNode(&node->values[i]);
+        error = parseObjectNode(&builder, &ctx);
+    }
+    else
+    {
+        error = parseArrayNode(&builder, &ctx);
     }
 
-    // We only have to clean a string node, other node types are self-cleaning
-    if (node->type == STRING_NODE)
+    if (error != ERR_NOERROR)
     {
-        cleanJSONString(node->stringValue);
+        return error;
     }
+
+    *node = builder.root;
+
+    return ERR_NOERROR;
 }
 
-JSON_API JSONError JSONParse(JSONNode *tree, const char *input, size_t inputLength)
+// Parsing again drops the previous tree, its memory is kept for the next one
+void resetDocument(JSONDocument *document)
+{
+    resetArena(&document->arena);
+    unmapFile(&document->mapping);
+    document->tape.length = 0;
+    document->snapshot = NULL;
+    memset(&document->root, 0, sizeof(JSONNode));
+}
+
+JSON_API JSONDocument* JSONCreateDocument(void)
+{
+    return JSONCreateDocumentWithAllocator(NULL);
+}
+
+JSON_API JSONDocument* JSONCreateDocumentWithAllocator(const JSONAllocator *allocator)
+{
+    allocator = getAllocator(allocator);
+
+    JSONDocument *document = (JSONDocument *) allocMemory(allocator, sizeof(JSONDocument));
+    if (!document)
+    {
+        return NULL;
+    }
+
+    memset(document, 0, sizeof(JSONDocument));
+    document->allocator = *allocator;
+    initArena(&document->arena, &document->allocator);
+    initParseScratch(&document->scratch, &document->allocator);
+    initParseScratch(&document->lazyScratch, &document->allocator);
+    document->tape.allocator = &document->allocator;
+
+    return document;
+}
+
+JSON_API void JSONFreeDocument(JSONDocument *document)
+{
+    if (!document)
+    {
+        return;
+    }
+
+    freeArena(&document->arena);
+    freeParseScratch(&document->scratch);
+    freeParseScratch(&document->lazyScratch);
+    unmapFile(&document->mapping);
+    freeTape(&document->tape);
+
+    // The document holds the allocator it is freed with
+    JSONAllocator allocator = document->allocator;
+    freeMemory(&allocator, document);
+}
+
+JSON_API JSONNode* JSONDocumentGetRoot(JSONDocument *document)
+{
+    if (document->snapshot)
+    {
+        return makeTapeNode(document->snapshot);
+    }
+
+    if (document->tape.length > 0)
+    {
+        return makeTapeNode(document->tape.words);
+    }
+
+    return &document->root;
+}
+
+JSONError parseDocumentRoot(JSONDocument *document, ParseScratch *scratch, const char *input, size_t inputLength,
+                            uint32_t flags, const Projection *projection, JSONNode *root)
 {
     JSONError error;
     size_t index = 0;
 
+    if (inputLength == 0)
+    {
+        return ERR_INVALID_TREE_SYNTAX;
+    }
+
     parseContext ctx = {};
     ctx.input = input;
     ctx.inputLength = inputLength;
+    ctx.index = &index;
+    ctx.scratch = scratch;
+    ctx.flags = flags;
+    ctx.projection = projection;
+
+    DomBuilder builder;
+    initDomBuilder(&builder, document, scratch, flags);
 
-    ctx.index = &(index);
-    switch (input[index++])
+    if ((error = parseInput(&builder, &ctx)) == ERR_NOERROR)
     {
-        case '{':
-        {
-            bool parsedSomething = false;
-            error = parseObjectNode(tree, &ctx, &parsedSomething);
-            goto done;
-        }
-        case '[':
-        {
-            bool parsedSomething = false;
-            error = parseArrayNode(tree, &ctx, &parsedSomething);
-            goto done;
-        }
-        default:
+        *root = builder.root;
+    }
+
+    return error;
+}
+
+JSONError parseDocumentTape(JSONDocument *document, const char *input, size_t inputLength, uint32_t flags,
+                            const Projection *projection)
+{
+    JSONError error;
+    size_t index = 0;
+
+    if (inputLength == 0)
+    {
+        return ERR_INVALID_TREE_SYNTAX;
+    }
+
+    // Only the root is ever built, lazy containers would need nodes
+    flags &= ~(uint32_t) (JSON_PARSE_LAZY | JSON_PARSE_PARALLEL);
+
+    // NOTE(vincent): about a word per 8 bytes of input on typical documents,
+    // so the tape is rarely grown more than once.
+    Tape *tape = &document->tape;
+    if (tape->capacity < inputLength / 8 + 16)
+    {
+        if ((error = growTape(tape, inputLength / 8 + 16)) != ERR_NOERROR)
         {
-            return ERR_INVALID_TREE_SYNTAX;
+            return error;
         }
     }
 
-done:
-    if (error != ERR_NOERROR && error != ERR_EOF)
+    parseContext ctx = {};
+    ctx.input = input;
+    ctx.inputLength = inputLength;
+    ctx.index = &index;
+    ctx.scratch = &document->scratch;
+    ctx.flags = flags;
+    ctx.projection = projection;
+
+    TapeBuilder builder = {};
+    builder.tape = tape;
+    builder.flags = flags;
+
+    if ((error = parseInput(&builder, &ctx)) != ERR_NOERROR)
+    {
+        tape->length = 0;
+    }
+
+    return error;
+}
+
+JSONError parseDocument(JSONDocument *document, const char *input, size_t inputLength, uint32_t flags,
+                        uint32_t threadCount, const Projection *projection)
+{
+    if (flags & JSON_PARSE_TAPE)
+    {
+        return parseDocumentTape(document, input, inputLength, flags, projection);
+    }
+
+    // NOTE(vincent): the parts start inside the root array, the projection
+    // would have to be followed from there. Projected parses are small anyway.
+    if ((flags & JSON_PARSE_PARALLEL) && !projection)
+    {
+        return parseArrayInParallel(document, input, inputLength, flags, threadCount);
+    }
+
+    return parseDocumentRoot(document, &document->scratch, input, inputLength, flags, projection,
+                             &document->root);
+}
+
+JSON_API JSONError JSONParseDocument(JSONDocument *document, const char *input, size_t inputLength,
+                                     const JSONParseOptions *options)
+{
+    resetDocument(document);
+
+    uint32_t flags = options ? options->flags : (uint32_t) JSON_PARSE_DEFAULT;
+    uint32_t threadCount = options ? options->threadCount : 0;
+    document->keyTable = options ? options->keyTable : NULL;
+
+    Projection projection = {};
+    if (options && initProjection(&projection, options->projection, options->projectionCount) != ERR_NOERROR)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    const Projection *projected = projection.rootMask ? &projection : NULL;
+
+#if defined(JSON_STATS)
+    JSONParseStats *stats = options ? options->stats : NULL;
+    if (stats)
     {
+        memset(stats, 0, sizeof(JSONParseStats));
+        stats->bytesProcessed = inputLength;
+
+        StatsAllocator counting;
+        startAllocationStats(&counting, &document->allocator, stats);
+        document->scratch.stats = stats;
+
+        uint64_t parseStart = getStatsTime();
+        JSONError error = parseDocument(document, input, inputLength, flags, threadCount, projected);
+        stats->parseNanoseconds = getStatsTime() - parseStart - stats->indexNanoseconds;
+
+        document->scratch.stats = NULL;
+        stopAllocationStats(&counting, &document->allocator);
+
         return error;
     }
+#endif
 
-    return ERR_NOERROR;
+    return parseDocument(document, input, inputLength, flags, threadCount, projected);
 }
 
-struct JSONIterator
+JSON_API JSONError JSONParseFile(JSONDocument *document, const char *path, const JSONParseOptions *options)
 {
-    JSONNode *node;
-    size_t index;
-};
+    JSONError error;
+    FileMapping mapping;
 
-JSON_API JSONIterator* JSONCreateIterator(JSONNode *node)
+    STATS_TIMER(mapStart);
+
+    if ((error = mapFile(&mapping, path, true)) != ERR_NOERROR)
+    {
+        resetDocument(document);
+        return error;
+    }
+
+    STATS_TIMER(mapEnd);
+
+    // Clears the stats, the mapping is only added once it is done
+    error = JSONParseDocument(document, mapping.data, mapping.length, options);
+
+    STATS_ADD(options ? options->stats : NULL, mapNanoseconds, mapEnd - mapStart);
+
+    // Otherwise everything was copied in the arena
+    uint32_t flags = options ? options->flags : (uint32_t) JSON_PARSE_DEFAULT;
+    if (error == ERR_NOERROR && (flags & (JSON_PARSE_VIEW_STRINGS | JSON_PARSE_LAZY)))
+    {
+        document->mapping = mapping;
+    }
+    else
+    {
+        unmapFile(&mapping);
+    }
+
+    return error;
+}
+
+//
+// Events API
+//
+
+JSON_API JSONError JSONParseEvents(const char *input, size_t inputLength, const JSONParseOptions *options,
+                                   const JSONHandler *handler, void *userData)
+{
+    JSONError error;
+    size_t index = 0;
+
+    if (!handler)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    if (inputLength == 0)
+    {
+        return ERR_INVALID_TREE_SYNTAX;
+    }
+
+    Projection projection = {};
+    if (options && initProjection(&projection, options->projection, options->projectionCount) != ERR_NOERROR)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    EventHandler events = {};
+    events.handler = handler;
+    events.userData = userData;
+
+    const JSONAllocator *allocator = options ? options->allocator : NULL;
+
+#if defined(JSON_STATS)
+    JSONParseStats *stats = options ? options->stats : NULL;
+    JSONAllocator countedAllocator = *getAllocator(allocator);
+    StatsAllocator counting;
+
+    if (stats)
+    {
+        memset(stats, 0, sizeof(JSONParseStats));
+        stats->bytesProcessed = inputLength;
+
+        startAllocationStats(&counting, &countedAllocator, stats);
+        allocator = &countedAllocator;
+    }
+#endif
+
+    ParseScratch scratch;
+    initParseScratch(&scratch, allocator);
+
+#if defined(JSON_STATS)
+    scratch.stats = stats;
+#endif
+
+    parseContext ctx = {};
+    ctx.input = input;
+    ctx.inputLength = inputLength;
+    ctx.index = &index;
+    ctx.scratch = &scratch;
+    ctx.flags = options ? options->flags : (uint32_t) JSON_PARSE_DEFAULT;
+    ctx.flags &= ~(uint32_t) JSON_PARSE_LAZY;
+    ctx.projection = projection.rootMask ? &projection : NULL;
+
+    // Strings without escapes are always handed over in place, the handler
+    // ignores the flag but JSONParseStats counts them as views.
+    ctx.flags |= JSON_PARSE_VIEW_STRINGS;
+
+    STATS_TIMER(parseStart);
+
+    error = parseInput(&events, &ctx);
+
+    freeParseScratch(&scratch);
+
+#if defined(JSON_STATS)
+    if (stats)
+    {
+        stats->parseNanoseconds = getStatsTime() - parseStart - stats->indexNanoseconds;
+    }
+#endif
+
+    return error;
+}
+
+// NOTE(vincent): JSONCreateNode/JSONFreeNode/JSONParse are kept for existing
+// callers, the node they work on is the root of a hidden document.
+JSONNode* objectGetWithHash(JSONNode *node, const char *key, size_t keyLength, uint32_t hash)
+{
+    if (JSONGetNodeType(node) != OBJECT_NODE)
+    {
+        return NULL;
+    }
+
+    if (isTapePointer(node))
+    {
+        const uint64_t *value = findTapeKey(getTapeWord(node), key, keyLength);
+        return value ? makeTapeNode(value) : NULL;
+    }
+
+    if (node->lazy && materializeNode(node) != ERR_NOERROR)
+    {
+        return NULL;
+    }
+
+    if (!node->keys)
+    {
+        return NULL;
+    }
+
+    int64_t index = findInJSONStringArray(node->keys, key, keyLength, hash);
+    if (index < 0)
+    {
+        return NULL;
+    }
+
+    return &node->values[index];
+}
+
+JSON_API JSONNode* JSONObjectGet(JSONNode *node, const char *key, size_t keyLength)
+{
+    return objectGetWithHash(node, key, keyLength, hashKey(key, keyLength));
+}
+
+JSON_API JSONNode* JSONCreateNode(void)
+{
+    JSONDocument *document = JSONCreateDocument();
+    if (!document)
+    {
+        return NULL;
+    }
+
+    return &document->root;
+}
+
+JSON_API void JSONFreeNode(JSONNode *node)
+{
+    JSONFreeDocument((JSONDocument *) node);
+}
+
+JSON_API JSONError JSONParse(JSONNode *tree, const char *input, size_t inputLength)
+{
+    return JSONParseDocument((JSONDocument *) tree, input, inputLength, NULL);
+}
+
+void initIterator(JSONIterator *iter, JSONNode *node)
 {
-    JSONIterator *iter = (JSONIterator*) malloc(sizeof(JSONIterator));
     iter->node = node;
     iter->index = 0;
+}
+
+JSON_API JSONIterator* JSONCreateIterator(JSONNode *node)
+{
+    return JSONCreateIteratorWithAllocator(node, NULL);
+}
+
+JSON_API JSONIterator* JSONCreateIteratorWithAllocator(JSONNode *node, const JSONAllocator *allocator)
+{
+    allocator = getAllocator(allocator);
+
+    JSONIterator *iter = (JSONIterator*) allocMemory(allocator, sizeof(JSONIterator));
+    if (!iter)
+    {
+        return NULL;
+    }
+
+    initIterator(iter, node);
+    iter->allocator = *allocator;
 
     return iter;
 }
 
 JSON_API void JSONFreeIterator(JSONIterator *iter)
 {
-    free(iter);
+    if (!iter)
+    {
+        return;
+    }
+
+    JSONAllocator allocator = iter->allocator;
+    freeMemory(&allocator, iter);
+}
+
+// On a tape the index is the distance from the container word to the next
+// element, 0 before the first one
+JSONError getNextTapeValue(JSONIterator *iter, JSONString **key, JSONNode **value)
+{
+    const uint64_t *container = getTapeWord(iter->node);
+    TapeTag tag = getTapeTag(*container);
+
+    if (tag != TAPE_OBJECT_START && tag != TAPE_ARRAY_START)
+    {
+        return ERR_ITERATOR_NO_MORE_ELEMENTS;
+    }
+
+    const uint64_t *word = container + (iter->index ? iter->index : 1);
+    TapeTag next = getTapeTag(*word);
+    if (next == TAPE_OBJECT_END || next == TAPE_ARRAY_END)
+    {
+        return ERR_ITERATOR_NO_MORE_ELEMENTS;
+    }
+
+    if (tag == TAPE_OBJECT_START)
+    {
+        *key = makeTapeString(word);
+        word = skipTapeValue(word);
+    }
+    *value = makeTapeNode(word);
+
+    iter->index = (size_t) (skipTapeValue(word) - container);
+
+    return ERR_NOERROR;
 }
 
 JSON_API JSONError JSONIteratorGetNext(JSONIterator *iter, JSONString **key, JSONNode **value)
@@ -843,7 +1942,7 @@ JSON_API JSONError JSONIteratorGetNext(JSONIterator *iter, JSONString **key, JSO
         return ERR_ITERATOR_INVALID_NODE;
     }
 
-    if (iter->node->type == OBJECT_NODE && !key)
+    if (JSONGetNodeType(iter->node) == OBJECT_NODE && !key)
     {
         return ERR_ITERATOR_INVALID_KEY_PTR;
     }
@@ -853,6 +1952,21 @@ JSON_API JSONError JSONIteratorGetNext(JSONIterator *iter, JSONString **key, JSO
         return ERR_ITERATOR_INVALID_VALUE_PTR;
     }
 
+    if (isTapePointer(iter->node))
+    {
+        return getNextTapeValue(iter, key, value);
+    }
+
+    JSONNodeType type = iter->node->type;
+    if ((type == OBJECT_NODE || type == ARRAY_NODE) && iter->node->lazy)
+    {
+        JSONError error = materializeNode(iter->node);
+        if (error != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
     if (iter->index >= iter->node->length)
     {
         return ERR_ITERATOR_NO_MORE_ELEMENTS;
@@ -1,12 +1,24 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
-#if defined(BUILDING_JSON)
+// JSON_STATIC must be defined when linking the static library on Windows.
+// Elsewhere the library is built with hidden visibility, only JSON_API
+// functions are exported from the shared object.
+#if defined(_WIN32)
+#if defined(JSON_STATIC)
+#define JSON_API
+#elif defined(BUILDING_JSON)
 #define JSON_API __declspec(dllexport)
 #else
 #define JSON_API __declspec(dllimport)
 #endif
+#elif defined(BUILDING_JSON)
+#define JSON_API __attribute__((visibility("default")))
+#else
+#define JSON_API
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -26,6 +38,13 @@ enum JSONError
     ERR_INVALID_ARRAY_SYNTAX,
     ERR_INVALID_NULL_SYNTAX,
     ERR_OUTPUT_BUFFER_TOO_SMALL,
+    ERR_OUT_OF_MEMORY,
+    ERR_INVALID_ARGUMENT,
+    ERR_CANNOT_READ_FILE,
+    ERR_INVALID_UTF8,
+    ERR_TYPE_MISMATCH,
+    ERR_CANNOT_WRITE_FILE,
+    ERR_INVALID_BINARY,
 
     ERR_ITERATOR_INVALID_NODE,
     ERR_ITERATOR_INVALID_KEY_PTR,
@@ -47,14 +66,10 @@ enum JSONNodeType
 
 JSON_API const char* JSONNodeTypeToString(JSONNodeType type);
 
-#define MAX_KEYS 16
-#define MAX_VALUES 16
-
-#define MAX_CHILDREN_PER_NODE 2048
-
 typedef struct JSONString JSONString;
 
 JSON_API char* JSONStringGetData(JSONString *string);
+JSON_API size_t JSONStringGetLength(JSONString *string);
 
 typedef struct JSONNode JSONNode;
 
@@ -64,16 +79,269 @@ JSON_API bool JSONNodeGetBool(JSONNode *node);
 JSON_API int64_t JSONNodeGetInteger(JSONNode *node);
 JSON_API double JSONNodeGetDouble(JSONNode *node);
 
+// Returns the value of the first `key` of an object node, or NULL. Large
+// objects are looked up through a hash table built while parsing.
+JSON_API JSONNode* JSONObjectGet(JSONNode *node, const char *key, size_t keyLength);
+
+enum JSONParseFlags
+{
+    JSON_PARSE_DEFAULT = 0,
+
+    // Strings without escapes point directly into the input instead of being
+    // copied: the input must outlive the document and the data is not NUL
+    // terminated, use JSONStringGetLength.
+    JSON_PARSE_VIEW_STRINGS = 1 << 0,
+
+    // Finds the end of the containers skipped without parsing, by
+    // JSON_PARSE_LAZY or a projection, with a SIMD pass locating every
+    // structural character of the input instead of scanning them. The pass
+    // runs when the first container is skipped: it pays off on deeply nested
+    // documents, parses skipping nothing ignore the flag.
+    JSON_PARSE_STRUCTURAL_INDEX = 1 << 1,
+
+    // Only the children of the root are parsed, nested containers are skipped
+    // and parsed the first time they are iterated or looked up, syntax errors
+    // inside them are only reported then. Like views, the input must outlive
+    // the document.
+    JSON_PARSE_LAZY = 1 << 2,
+
+    // A root array of at least 1 MiB is cut in parts with about the same size
+    // after a quick pass finding its elements, the parts are then parsed on
+    // threadCount threads. Only applies to JSONParseDocument.
+    JSON_PARSE_PARALLEL = 1 << 3,
+
+    // The document is stored as a single array of 64-bit words instead of a
+    // tree of nodes, read through the same node API. Iterating is a linear
+    // walk of memory, objects are looked up without a hash table. Only applies
+    // to JSONParseDocument and JSONParseFile, the lazy and parallel flags are
+    // ignored.
+    JSON_PARSE_TAPE = 1 << 4
+};
+
+// Replaces malloc, realloc and free, each function receives userData. realloc
+// must accept a NULL pointer like the C one. Whoever it is given to keeps a
+// copy, the struct itself does not have to outlive the call.
+typedef struct JSONAllocator
+{
+    void* (*alloc)(void *userData, size_t size);
+    void* (*realloc)(void *userData, void *ptr, size_t size);
+    void (*free)(void *userData, void *ptr);
+    void *userData;
+} JSONAllocator;
+
+// Used by JSONParseOptions, see their own sections below
+typedef struct JSONPath JSONPath;
+typedef struct JSONKeyTable JSONKeyTable;
+
+// What a parse went through, to find out why a document is slow. Only filled
+// when the library is built with JSON_STATS, otherwise the counting is compiled
+// out and the struct is left untouched. On error it describes the input up to
+// the error. Containers skipped by JSON_PARSE_LAZY count as one node, their
+// children are not counted when they are materialized later.
+typedef struct JSONParseStats
+{
+    size_t bytesProcessed;
+    size_t nodeCounts[NULL_NODE + 1]; // indexed by JSONNodeType
+    size_t maxDepth; // 1 for a root without nested containers
+
+    // Strings and keys copied in the document, or pointing in the input
+    size_t stringBytesCopied;
+    size_t stringBytesViewed;
+
+    // Calls to alloc and realloc, and the sizes they asked for
+    size_t allocationCount;
+    size_t allocationBytes;
+
+    uint64_t mapNanoseconds; // JSONParseFile mapping the file
+    uint64_t indexNanoseconds; // structural index, or finding the parallel parts
+    uint64_t parseNanoseconds; // everything else
+} JSONParseStats;
+
+typedef struct JSONParseOptions
+{
+    uint32_t flags; // JSONParseFlags
+    uint32_t threadCount; // JSON_PARSE_PARALLEL, 0 uses a thread per processor
+
+    // Used by parsers, batches and JSONParseEvents, NULL uses malloc. The
+    // trees always go to the allocator of their document.
+    const JSONAllocator *allocator;
+
+    // Filled by JSONParseDocument, JSONParseFile and JSONParseEvents, NULL to
+    // skip the counting
+    JSONParseStats *stats;
+
+    // Up to 64 compiled paths (see JSONPath) the parse is limited to, used by
+    // JSONParseDocument, JSONParseFile, JSONParseEvents and JSONParseMany, more
+    // or NULL ones are ERR_INVALID_ARGUMENT. Object members outside of them are
+    // left out and array elements replaced by null, so indices are kept. Their
+    // extent is found without parsing, like lazy containers, and their syntax
+    // errors are not reported. A matched value is parsed whole. The parallel
+    // flag is ignored.
+    JSONPath *const *projection;
+    size_t projectionCount;
+
+    // Keys shared by the trees of every parse given the same table, see
+    // JSONKeyTable. NULL copies them in each document.
+    JSONKeyTable *keyTable;
+} JSONParseOptions;
+
+// A document owns all the nodes and strings of a parsed tree in a single arena,
+// freeing it releases the whole tree at once. Parsing again in the same
+// document reuses that memory instead of releasing it.
+typedef struct JSONDocument JSONDocument;
+
+JSON_API JSONDocument* JSONCreateDocument();
+// The document and everything it holds are allocated with allocator, NULL uses malloc
+JSON_API JSONDocument* JSONCreateDocumentWithAllocator(const JSONAllocator *allocator);
+JSON_API void JSONFreeDocument(JSONDocument *document);
+JSON_API JSONNode* JSONDocumentGetRoot(JSONDocument *document);
+// options can be NULL to use the defaults
+JSON_API JSONError JSONParseDocument(JSONDocument *document, const char *input, size_t inputLength,
+                                     const JSONParseOptions *options);
+
+// Parses the file straight from a memory mapping instead of reading it in a
+// buffer. With view strings or lazy containers the mapping stays alive until
+// the document is parsed again or freed, so no byte of the file is copied.
+JSON_API JSONError JSONParseFile(JSONDocument *document, const char *path, const JSONParseOptions *options);
+
+// Binary snapshots of a tree, for documents loaded again and again: loading
+// maps the file and checks its layout in one pass over it, nothing is parsed.
+// Only checking trees nested more than 64 deep allocates, from the document's
+// allocator, until the check ends. The loaded tree is read in place through
+// the node API, like a JSON_PARSE_TAPE document, until the document is parsed
+// again or freed. Its strings are read only. Snapshots only load on machines
+// of the byte order they were saved on, anything else is ERR_INVALID_BINARY.
+JSON_API JSONError JSONSaveBinary(JSONNode *node, const char *path);
+// The words are built in memory from allocator before being written, NULL uses
+// malloc. Pass the allocator of the document node comes from.
+JSON_API JSONError JSONSaveBinaryWithAllocator(JSONNode *node, const char *path, const JSONAllocator *allocator);
+JSON_API JSONError JSONLoadBinary(JSONDocument *document, const char *path);
+
+// The node returned by JSONCreateNode is the root of its own document:
+// JSONFreeNode must only be called with it, never with a child node.
 JSON_API JSONNode* JSONCreateNode();
 JSON_API void JSONFreeNode(JSONNode *tree);
 JSON_API JSONError JSONParse(JSONNode *tree, const char *input, size_t inputLength);
 
+// Callbacks receiving the content of a document as it is parsed, without
+// building any tree. Each of them can be NULL, returning anything but
+// ERR_NOERROR stops the parse with that error. Strings are not NUL terminated
+// and only valid during the call.
+typedef struct JSONHandler
+{
+    JSONError (*startObject)(void *userData);
+    JSONError (*endObject)(void *userData);
+    JSONError (*startArray)(void *userData);
+    JSONError (*endArray)(void *userData);
+    JSONError (*key)(void *userData, const char *data, size_t length);
+    JSONError (*stringValue)(void *userData, const char *data, size_t length);
+    JSONError (*intValue)(void *userData, int64_t value);
+    JSONError (*doubleValue)(void *userData, double value);
+    JSONError (*booleanValue)(void *userData, bool value);
+    JSONError (*nullValue)(void *userData);
+} JSONHandler;
+
+// The lazy flag is ignored, everything is reported
+JSON_API JSONError JSONParseEvents(const char *input, size_t inputLength, const JSONParseOptions *options,
+                                   const JSONHandler *handler, void *userData);
+
+// Push parser for input arriving in chunks: tokens split across chunks are
+// carried over, so only the partial token is kept between calls, never the
+// chunks themselves. The tree is built in the document given at creation.
+// Strings are always copied and containers never lazy, the view and lazy
+// flags are ignored.
+typedef struct JSONParser JSONParser;
+
+JSON_API JSONParser* JSONCreateParser(JSONDocument *document, const JSONParseOptions *options);
+// Reports the content to the handler instead of building a document, memory
+// use stays bounded by the nesting depth and the longest token.
+JSON_API JSONParser* JSONCreateEventParser(const JSONHandler *handler, void *userData,
+                                           const JSONParseOptions *options);
+JSON_API void JSONFreeParser(JSONParser *parser);
+// Starts over with a new input, dropping the tree of the previous one. The
+// memory of the parser and its document is kept: once warmed up, documents of
+// a similar shape are parsed without any allocation.
+JSON_API void JSONParserReset(JSONParser *parser);
+// Errors are sticky, once a chunk fails every later call returns the error
+JSON_API JSONError JSONParserFeed(JSONParser *parser, const char *chunk, size_t length);
+// Call at the end of the input, returns ERR_EOF if the document is incomplete
+JSON_API JSONError JSONParserFinish(JSONParser *parser);
+JSON_API bool JSONParserIsComplete(JSONParser *parser);
+
+// Newline delimited documents (NDJSON, JSON Lines) parsed on several threads,
+// one document per line, blank lines are skipped. Each thread allocates in its
+// own arena, the trees are valid until JSONFreeBatch. Like for a document,
+// the view and lazy flags require the input to outlive the batch.
+typedef struct JSONBatch JSONBatch;
+
+// threadCount 0 uses a thread per processor. Returns NULL when out of memory
+// or given too many projection paths, syntax errors are reported per document.
+JSON_API JSONBatch* JSONParseMany(const char *input, size_t inputLength, const JSONParseOptions *options,
+                                  uint32_t threadCount);
+JSON_API void JSONFreeBatch(JSONBatch *batch);
+JSON_API size_t JSONBatchGetCount(JSONBatch *batch);
+// Returns the parse error of the document, root is NULL when there is one
+JSON_API JSONError JSONBatchGetDocument(JSONBatch *batch, size_t index, JSONNode **root);
+// Goes through the documents in input order, then returns ERR_ITERATOR_NO_MORE_ELEMENTS
+JSON_API JSONError JSONBatchGetNext(JSONBatch *batch, JSONNode **root);
+
 typedef struct JSONIterator JSONIterator;
 
 JSON_API JSONIterator* JSONCreateIterator(JSONNode *node);
+JSON_API JSONIterator* JSONCreateIteratorWithAllocator(JSONNode *node, const JSONAllocator *allocator);
 JSON_API void JSONFreeIterator(JSONIterator *iter);
 JSON_API JSONError JSONIteratorGetNext(JSONIterator *iter, JSONString **keyPtr, JSONNode **nodePtr);
 
+// JSON Pointers (RFC 6901) parsed once into steps, with the keys unescaped and
+// hashed and the array indices decoded, then evaluated against any number of
+// documents without allocating. A "*" token matches every member of an object
+// or element of an array, so a path can match several nodes: a member actually
+// named "*" cannot be addressed. "-" never matches, "" matches the node itself.
+
+// allocator can be NULL to use malloc. Returns ERR_INVALID_ARGUMENT when the
+// pointer does not start with '/' or has a '~' followed by neither 0 nor 1.
+JSON_API JSONError JSONPathCompile(const char *pointer, size_t pointerLength, const JSONAllocator *allocator,
+                                   JSONPath **path);
+JSON_API void JSONFreePath(JSONPath *path);
+// Stores the matches below node in document order and their number in count.
+// Returns ERR_OUTPUT_BUFFER_TOO_SMALL once capacity matches are stored and
+// another one is found. Lazy containers on the way are materialized.
+JSON_API JSONError JSONPathEval(JSONPath *path, JSONNode *node, JSONNode **results, size_t capacity,
+                                size_t *count);
+
+// Documents of a stream tend to repeat the same keys: parsed with a key table,
+// each distinct key is stored once in the table instead of once per object in
+// every document, and the keys of the trees point to that copy. Interning a
+// key in the table gives the same pointer, which lookups compare before the
+// bytes. Trees built by JSONParseDocument, JSONParseFile, JSONParseMany and
+// JSONCreateParser use it, tapes keep their keys inline.
+//
+// Parses can share a table from any number of threads: lookups never lock,
+// new keys are added with a compare and swap. Keys are never removed, once
+// maxKeys are in the table the others are copied in their documents as
+// without one. The table must outlive the documents parsed with it.
+// Returns NULL when out of memory, maxKeys too large included.
+JSON_API JSONKeyTable* JSONCreateKeyTable(size_t maxKeys, const JSONAllocator *allocator);
+JSON_API void JSONFreeKeyTable(JSONKeyTable *table);
+// Returns the NUL terminated copy of key in the table, NULL when it is full
+JSON_API const char* JSONKeyTableIntern(JSONKeyTable *table, const char *key, size_t keyLength);
+
+enum JSONWriteFlags
+{
+    JSON_WRITE_COMPACT = 0,
+    JSON_WRITE_PRETTY = 1 << 0 // newlines and 4 spaces indentation
+};
+
+// Receives the output in chunks, returning anything but ERR_NOERROR aborts
+// the write with that error.
+typedef JSONError (*JSONWriteCallback)(void *userData, const char *data, size_t length);
+
+JSON_API JSONError JSONWrite(JSONNode *node, uint32_t flags, JSONWriteCallback callback, void *userData);
+
+// output is NUL terminated and must be released with JSONFreeSerialized
+JSON_API JSONError JSONSerialize(JSONNode *node, uint32_t flags, char **output, size_t *outputLength);
+JSON_API void JSONFreeSerialized(char *output);
+
 #ifdef __cplusplus
 }
 #endif
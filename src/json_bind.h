@@ -0,0 +1,536 @@
+#pragma once
+
+#include <float.h>
+#include <string.h>
+
+#include "json.h"
+
+// Decodes a document straight into C++ structs: the values reported by
+// JSONParseEvents are written to the fields as they are read, no tree is
+// built. A struct lists the members it takes once, at global scope:
+//
+//   struct Item { int64_t id; double price; char name[32]; };
+//
+//   JSON_BIND_STRUCT(Item)
+//       JSON_BIND_FIELD(id)
+//       JSON_BIND_FIELD(price)
+//       JSON_BIND_FIELD_NAMED(name, "display_name")
+//   JSON_BIND_END
+//
+//   Item item = {};
+//   JSONError error = JSONBindParse(input, inputLength, &item, NULL);
+//
+// Keys are dispatched with a switch on their hash, the one of each field is
+// computed at compile time: two fields with the same hash do not compile.
+// Members without a field are skipped, fields without a member and null values
+// are left untouched.
+//
+// Fields can be bool, integers, float, double, char arrays (NUL terminated),
+// bound structs, and JSONBindArray of any of them. Values of another type and
+// numbers out of the range of their field give ERR_TYPE_MISMATCH, strings and
+// arrays longer than their field ERR_OUTPUT_BUFFER_TOO_SMALL.
+//
+// The parser reports integers past INT64_MAX as doubles, already rounded to
+// 53 bits: uint64_t fields refuse them with ERR_TYPE_MISMATCH rather than
+// storing a value the document does not hold. Read such numbers as double.
+
+// Only bound values take a level, skipped members are counted without one.
+// Bound values nested deeper are ERR_INVALID_ARGUMENT: only structs nesting
+// each other that deep can reach it, whatever the document.
+#define JSON_BIND_MAX_DEPTH 64
+
+// Fixed capacity array, count is the number of elements decoded
+template <typename T, size_t N>
+struct JSONBindArray
+{
+    T items[N];
+    size_t count;
+};
+
+struct JSONBindType;
+
+// Where a value goes and how to write it, type is NULL for values skipped
+struct JSONBindTarget
+{
+    void *ptr;
+    const JSONBindType *type;
+};
+
+// One static instance per bound C++ type
+struct JSONBindType
+{
+    JSONNodeType container; // OBJECT_NODE, ARRAY_NODE or UNKNOWN for scalars
+
+    JSONError (*setInteger)(void *ptr, int64_t value);
+    JSONError (*setDouble)(void *ptr, double value);
+    JSONError (*setBoolean)(void *ptr, bool value);
+    JSONError (*setString)(void *ptr, const char *data, size_t length);
+
+    // Objects: the target of the member named key
+    JSONBindTarget (*getField)(void *ptr, const char *key, size_t keyLength);
+
+    // Arrays: emptied when they start, then each element is added in turn
+    void (*clear)(void *ptr);
+    JSONError (*addElement)(void *ptr, JSONBindTarget *element);
+};
+
+// Specialized for each type a field can have
+template <typename T>
+struct JSONBindTraits;
+
+template <typename T>
+inline JSONBindTarget makeBindTarget(T *ptr)
+{
+    JSONBindTarget target = { ptr, JSONBindTraits<T>::getType() };
+    return target;
+}
+
+//
+// Key hashes
+//
+
+// FNV-1a, evaluated by the compiler for the case labels of the fields
+constexpr uint32_t jsonBindHash(const char *key, size_t length, uint32_t hash = 2166136261u)
+{
+    return length == 0 ? hash : jsonBindHash(key + 1, length - 1, (hash ^ (uint8_t) key[0]) * 16777619u);
+}
+
+// Same as jsonBindHash for the keys read, without the recursion
+inline uint32_t jsonBindKeyHash(const char *key, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ (uint8_t) key[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+template <typename T>
+inline JSONBindTarget jsonBindField(const char *name, size_t nameLength, const char *key, size_t keyLength,
+                                    T *field)
+{
+    // The hashes matched, the key can still be another one
+    if (keyLength != nameLength || memcmp(name, key, keyLength) != 0)
+    {
+        JSONBindTarget skipped = {};
+        return skipped;
+    }
+
+    return makeBindTarget(field);
+}
+
+//
+// Setters
+//
+
+inline JSONError jsonBindMismatchInteger(void *, int64_t)
+{
+    return ERR_TYPE_MISMATCH;
+}
+
+inline JSONError jsonBindMismatchDouble(void *, double)
+{
+    return ERR_TYPE_MISMATCH;
+}
+
+inline JSONError jsonBindMismatchBoolean(void *, bool)
+{
+    return ERR_TYPE_MISMATCH;
+}
+
+inline JSONError jsonBindMismatchString(void *, const char *, size_t)
+{
+    return ERR_TYPE_MISMATCH;
+}
+
+template <typename T>
+inline JSONError jsonBindSetInteger(void *ptr, int64_t value)
+{
+    // Values out of range do not convert back, or change sign for uint64_t
+    T converted = (T) value;
+    if ((int64_t) converted != value || (value < 0 && converted > 0))
+    {
+        return ERR_TYPE_MISMATCH;
+    }
+
+    *(T *) ptr = converted;
+    return ERR_NOERROR;
+}
+
+template <typename T>
+inline JSONError jsonBindSetFloatFromInteger(void *ptr, int64_t value)
+{
+    *(T *) ptr = (T) value;
+    return ERR_NOERROR;
+}
+
+template <typename T>
+inline JSONError jsonBindSetFloat(void *ptr, double value)
+{
+    *(T *) ptr = (T) value;
+    return ERR_NOERROR;
+}
+
+// Converting a double out of the range of float is undefined
+template <>
+inline JSONError jsonBindSetFloat<float>(void *ptr, double value)
+{
+    if (value > FLT_MAX || value < -FLT_MAX)
+    {
+        return ERR_TYPE_MISMATCH;
+    }
+
+    *(float *) ptr = (float) value;
+    return ERR_NOERROR;
+}
+
+inline JSONError jsonBindSetBoolean(void *ptr, bool value)
+{
+    *(bool *) ptr = value;
+    return ERR_NOERROR;
+}
+
+template <size_t N>
+inline JSONError jsonBindSetString(void *ptr, const char *data, size_t length)
+{
+    if (length >= N)
+    {
+        return ERR_OUTPUT_BUFFER_TOO_SMALL;
+    }
+
+    memcpy(ptr, data, length);
+    ((char *) ptr)[length] = '\0';
+
+    return ERR_NOERROR;
+}
+
+//
+// Traits
+//
+
+template <typename T>
+struct JSONBindIntegerTraits
+{
+    static const JSONBindType* getType()
+    {
+        static const JSONBindType type = {
+            UNKNOWN, jsonBindSetInteger<T>, jsonBindMismatchDouble, jsonBindMismatchBoolean,
+            jsonBindMismatchString, NULL, NULL, NULL
+        };
+        return &type;
+    }
+};
+
+template <> struct JSONBindTraits<int8_t> : JSONBindIntegerTraits<int8_t> {};
+template <> struct JSONBindTraits<int16_t> : JSONBindIntegerTraits<int16_t> {};
+template <> struct JSONBindTraits<int32_t> : JSONBindIntegerTraits<int32_t> {};
+template <> struct JSONBindTraits<int64_t> : JSONBindIntegerTraits<int64_t> {};
+template <> struct JSONBindTraits<uint8_t> : JSONBindIntegerTraits<uint8_t> {};
+template <> struct JSONBindTraits<uint16_t> : JSONBindIntegerTraits<uint16_t> {};
+template <> struct JSONBindTraits<uint32_t> : JSONBindIntegerTraits<uint32_t> {};
+template <> struct JSONBindTraits<uint64_t> : JSONBindIntegerTraits<uint64_t> {};
+
+// Integers are taken too, "1" is as much a double as "1.0"
+template <typename T>
+struct JSONBindFloatTraits
+{
+    static const JSONBindType* getType()
+    {
+        static const JSONBindType type = {
+            UNKNOWN, jsonBindSetFloatFromInteger<T>, jsonBindSetFloat<T>, jsonBindMismatchBoolean,
+            jsonBindMismatchString, NULL, NULL, NULL
+        };
+        return &type;
+    }
+};
+
+template <> struct JSONBindTraits<float> : JSONBindFloatTraits<float> {};
+template <> struct JSONBindTraits<double> : JSONBindFloatTraits<double> {};
+
+template <>
+struct JSONBindTraits<bool>
+{
+    static const JSONBindType* getType()
+    {
+        static const JSONBindType type = {
+            UNKNOWN, jsonBindMismatchInteger, jsonBindMismatchDouble, jsonBindSetBoolean,
+            jsonBindMismatchString, NULL, NULL, NULL
+        };
+        return &type;
+    }
+};
+
+template <size_t N>
+struct JSONBindTraits<char[N]>
+{
+    static const JSONBindType* getType()
+    {
+        static const JSONBindType type = {
+            UNKNOWN, jsonBindMismatchInteger, jsonBindMismatchDouble, jsonBindMismatchBoolean,
+            jsonBindSetString<N>, NULL, NULL, NULL
+        };
+        return &type;
+    }
+};
+
+template <typename T, size_t N>
+struct JSONBindTraits<JSONBindArray<T, N> >
+{
+    static void clear(void *ptr)
+    {
+        ((JSONBindArray<T, N> *) ptr)->count = 0;
+    }
+
+    // Elements are value initialized, nothing of the previous decode is kept
+    static JSONError addElement(void *ptr, JSONBindTarget *element)
+    {
+        JSONBindArray<T, N> *array = (JSONBindArray<T, N> *) ptr;
+        if (array->count == N)
+        {
+            return ERR_OUTPUT_BUFFER_TOO_SMALL;
+        }
+
+        T *item = &array->items[array->count++];
+        *item = T();
+        *element = makeBindTarget(item);
+
+        return ERR_NOERROR;
+    }
+
+    static const JSONBindType* getType()
+    {
+        static const JSONBindType type = {
+            ARRAY_NODE, jsonBindMismatchInteger, jsonBindMismatchDouble, jsonBindMismatchBoolean,
+            jsonBindMismatchString, NULL, clear, addElement
+        };
+        return &type;
+    }
+};
+
+#define JSON_BIND_STRUCT(Type)                                                                          \
+    template <>                                                                                         \
+    struct JSONBindTraits<Type>                                                                         \
+    {                                                                                                   \
+        static const JSONBindType* getType()                                                            \
+        {                                                                                               \
+            static const JSONBindType type = {                                                          \
+                OBJECT_NODE, jsonBindMismatchInteger, jsonBindMismatchDouble, jsonBindMismatchBoolean,  \
+                jsonBindMismatchString, getField, NULL, NULL                                            \
+            };                                                                                          \
+            return &type;                                                                               \
+        }                                                                                               \
+                                                                                                        \
+        static JSONBindTarget getField(void *ptr, const char *key, size_t keyLength)                    \
+        {                                                                                               \
+            Type *object = (Type *) ptr;                                                                \
+            (void) object;                                                                              \
+                                                                                                        \
+            switch (jsonBindKeyHash(key, keyLength))                                                    \
+            {
+
+#define JSON_BIND_FIELD_NAMED(field, name)                                                              \
+                case jsonBindHash(name, sizeof(name) - 1):                                              \
+                    return jsonBindField(name, sizeof(name) - 1, key, keyLength, &object->field);
+
+#define JSON_BIND_FIELD(field) JSON_BIND_FIELD_NAMED(field, #field)
+
+#define JSON_BIND_END                                                                                   \
+            }                                                                                           \
+                                                                                                        \
+            JSONBindTarget skipped = {};                                                                \
+            return skipped;                                                                             \
+        }                                                                                               \
+    };
+
+//
+// Event handler
+//
+
+struct JSONBinder
+{
+    // Containers being decoded, the innermost last
+    JSONBindTarget frames[JSON_BIND_MAX_DEPTH];
+    size_t depth;
+
+    JSONBindTarget root;
+    JSONBindTarget member; // target of the value after the last key
+
+    // Containers without a target and everything in them are skipped
+    size_t skipDepth;
+};
+
+// The value about to be read goes to the root, the member after the last key
+// or a new element of the array
+inline JSONError getBindValueTarget(JSONBinder *binder, JSONBindTarget *target)
+{
+    if (binder->depth == 0)
+    {
+        *target = binder->root;
+        return ERR_NOERROR;
+    }
+
+    const JSONBindTarget *parent = &binder->frames[binder->depth - 1];
+    if (parent->type->container == ARRAY_NODE)
+    {
+        return parent->type->addElement(parent->ptr, target);
+    }
+
+    *target = binder->member;
+    return ERR_NOERROR;
+}
+
+inline JSONError startBindContainer(JSONBinder *binder, JSONNodeType container)
+{
+    JSONError error;
+    JSONBindTarget target;
+
+    if (binder->skipDepth > 0)
+    {
+        binder->skipDepth++;
+        return ERR_NOERROR;
+    }
+
+    if ((error = getBindValueTarget(binder, &target)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    if (!target.type)
+    {
+        binder->skipDepth = 1;
+        return ERR_NOERROR;
+    }
+
+    if (target.type->container != container)
+    {
+        return ERR_TYPE_MISMATCH;
+    }
+
+    if (binder->depth == JSON_BIND_MAX_DEPTH)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    if (container == ARRAY_NODE)
+    {
+        target.type->clear(target.ptr);
+    }
+
+    binder->frames[binder->depth++] = target;
+
+    return ERR_NOERROR;
+}
+
+inline JSONError endBindContainer(JSONBinder *binder)
+{
+    if (binder->skipDepth > 0)
+    {
+        binder->skipDepth--;
+    }
+    else
+    {
+        binder->depth--;
+    }
+
+    return ERR_NOERROR;
+}
+
+inline JSONError bindStartObject(void *userData)
+{
+    return startBindContainer((JSONBinder *) userData, OBJECT_NODE);
+}
+
+inline JSONError bindStartArray(void *userData)
+{
+    return startBindContainer((JSONBinder *) userData, ARRAY_NODE);
+}
+
+inline JSONError bindEndContainer(void *userData)
+{
+    return endBindContainer((JSONBinder *) userData);
+}
+
+inline JSONError bindKey(void *userData, const char *data, size_t length)
+{
+    JSONBinder *binder = (JSONBinder *) userData;
+
+    if (binder->skipDepth == 0)
+    {
+        const JSONBindTarget *object = &binder->frames[binder->depth - 1];
+        binder->member = object->type->getField(object->ptr, data, length);
+    }
+
+    return ERR_NOERROR;
+}
+
+// Scalars go through here, they have nothing to skip below them
+#define JSON_BIND_SCALAR(binder, setter, ...)                                                           \
+    do                                                                                                  \
+    {                                                                                                   \
+        JSONError bindError;                                                                            \
+        JSONBindTarget bindTarget;                                                                      \
+                                                                                                        \
+        if ((binder)->skipDepth > 0)                                                                    \
+        {                                                                                               \
+            return ERR_NOERROR;                                                                         \
+        }                                                                                               \
+                                                                                                        \
+        if ((bindError = getBindValueTarget(binder, &bindTarget)) != ERR_NOERROR)                       \
+        {                                                                                               \
+            return bindError;                                                                           \
+        }                                                                                               \
+                                                                                                        \
+        return bindTarget.type ? bindTarget.type->setter(bindTarget.ptr, __VA_ARGS__) : ERR_NOERROR;    \
+    } while (0)
+
+inline JSONError bindString(void *userData, const char *data, size_t length)
+{
+    JSON_BIND_SCALAR((JSONBinder *) userData, setString, data, length);
+}
+
+inline JSONError bindInteger(void *userData, int64_t value)
+{
+    JSON_BIND_SCALAR((JSONBinder *) userData, setInteger, value);
+}
+
+inline JSONError bindDouble(void *userData, double value)
+{
+    JSON_BIND_SCALAR((JSONBinder *) userData, setDouble, value);
+}
+
+inline JSONError bindBoolean(void *userData, bool value)
+{
+    JSON_BIND_SCALAR((JSONBinder *) userData, setBoolean, value);
+}
+
+// Leaves the field untouched, an element is still added to arrays
+inline JSONError bindNull(void *userData)
+{
+    JSONBinder *binder = (JSONBinder *) userData;
+    JSONBindTarget target;
+
+    return binder->skipDepth > 0 ? ERR_NOERROR : getBindValueTarget(binder, &target);
+}
+
+#undef JSON_BIND_SCALAR
+
+// object must be a bound struct or a JSONBindArray, matching the root of the
+// input. options are passed to JSONParseEvents, the lazy flag is ignored. On
+// error object is left partly decoded.
+template <typename T>
+JSONError JSONBindParse(const char *input, size_t inputLength, T *object, const JSONParseOptions *options)
+{
+    static const JSONHandler handler = {
+        bindStartObject, bindEndContainer, bindStartArray, bindEndContainer, bindKey,
+        bindString, bindInteger, bindDouble, bindBoolean, bindNull
+    };
+
+    JSONBinder binder;
+    binder.depth = 0;
+    binder.root = makeBindTarget(object);
+    binder.skipDepth = 0;
+
+    return JSONParseEvents(input, inputLength, options, &handler, &binder);
+}
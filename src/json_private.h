@@ -0,0 +1,219 @@
+#pragma once
+
+#include "arena.h"
+#include "buffer.h"
+#include "mapping.h"
+#include "stats.h"
+#include "structural.h"
+#include "json.h"
+
+// Definitions shared between the library modules, not part of the public API
+
+struct JSONString
+{
+    char *data;
+    size_t length;
+};
+
+struct JSONStringArray
+{
+    JSONString *underlying;
+    uint32_t *hashes;
+    size_t capacity;
+    size_t index;
+
+    // Open addressing table of key index + 1 (0 is an empty slot), NULL for
+    // small objects
+    uint32_t *table;
+    size_t tableMask;
+};
+
+// Extent in the input of a container whose children have not been parsed yet
+struct LazySpan
+{
+    const char *begin; // opening bracket
+    size_t length;     // up to and including the closing bracket
+    JSONDocument *document;
+    uint32_t flags;
+};
+
+struct JSONNode
+{
+    JSONNodeType type;
+
+    JSONStringArray *keys;
+    JSONNode *values;
+    size_t length;
+
+    union
+    {
+        JSONString *stringValue;
+        bool booleanValue;
+        int64_t intValue;
+        double doubleValue;
+        LazySpan *lazy; // containers not materialized yet, see JSON_PARSE_LAZY
+    };
+};
+
+// Children of the containers being parsed are accumulated here, once a
+// container is closed its children are copied in the arena, sized exactly.
+struct NodeStack
+{
+    JSONString *keys;
+    uint32_t *keyHashes;
+    JSONNode *values;
+    size_t capacity;
+    size_t length;
+
+    const JSONAllocator *allocator;
+};
+
+// A container being built, see DomBuilder
+struct DomFrame
+{
+    JSONNodeType type;
+    size_t stackStart;
+
+    // Key of the container in its parent object
+    JSONString key;
+    uint32_t keyHash;
+};
+
+// Scratch memory of a parse, reused for every string and container and kept
+// by documents and parsers from one parse to the next
+struct ParseScratch
+{
+    Buffer *buffer; // created on the first string with escapes
+    NodeStack stack;
+
+    DomFrame *frames;
+    size_t frameCount;
+    size_t frameCapacity;
+
+    StructuralIndex structurals; // JSON_PARSE_STRUCTURAL_INDEX
+
+    const JSONAllocator *allocator;
+
+#if defined(JSON_STATS)
+    JSONParseStats *stats; // set for the duration of a parse asked to count
+#endif
+};
+
+struct Projection;
+
+struct parseContext
+{
+    const char *input;
+    size_t *index;
+    size_t inputLength;
+
+    ParseScratch *scratch;
+    uint32_t flags;
+
+    // Set with JSON_PARSE_STRUCTURAL_INDEX, built the first time a container
+    // is skipped. The next structural at or after the last skipped container
+    // is then positions[nextStructural].
+    StructuralIndex *structurals;
+    size_t nextStructural;
+    bool structuralsBuilt;
+
+    // Set with JSONParseOptions::projection. projectionMask has the paths still
+    // matching the container being parsed, the members of which match their
+    // step at projectionDepth. 0 when the container is parsed whole.
+    const Projection *projection;
+    uint64_t projectionMask;
+    size_t projectionDepth;
+
+#if defined(JSON_STATS)
+    size_t depth; // containers open, only tracked for JSONParseStats
+#endif
+};
+
+// Words of a JSON_PARSE_TAPE document, see tape.h
+struct Tape
+{
+    uint64_t *words;
+    size_t length;
+    size_t capacity;
+
+    const JSONAllocator *allocator;
+};
+
+struct JSONDocument
+{
+    // NOTE(vincent): the root must stay the first field, JSONCreateNode hands
+    // out a pointer to it and the legacy node API casts it back to the document.
+    JSONNode root;
+    Arena arena;
+
+    // Copy of the allocator given at creation, everything below points to it
+    JSONAllocator allocator;
+
+    // Parsing again reuses the chunks of the arena, the scratch and the tape,
+    // so after the first documents similar ones are parsed without allocating.
+    ParseScratch scratch;
+
+    // Used to materialize the containers skipped by JSON_PARSE_LAZY
+    ParseScratch lazyScratch;
+
+    // Input of JSONParseFile, kept while views or lazy containers point in it
+    FileMapping mapping;
+
+    // Replaces the nodes when parsed with JSON_PARSE_TAPE
+    Tape tape;
+
+    // Root word of JSONLoadBinary, in the mapping
+    const uint64_t *snapshot;
+
+    // JSONParseOptions::keyTable of the last parse, lazy containers use it too
+    JSONKeyTable *keyTable;
+};
+
+// Exposed so internal traversals can keep iterators on the stack
+struct JSONIterator
+{
+    JSONNode *node;
+    size_t index;
+
+    JSONAllocator allocator; // set by JSONCreateIterator only
+};
+
+void initIterator(JSONIterator *iter, JSONNode *node);
+
+uint32_t hashKey(const char *data, size_t length);
+
+// JSONObjectGet with the hash of the key already computed
+JSONNode* objectGetWithHash(JSONNode *node, const char *key, size_t keyLength, uint32_t hash);
+
+// Copies the data in the arena and NUL terminates it
+JSONError setJSONStringData(JSONString *string, Arena *arena, const char *data, size_t length);
+void setJSONStringView(JSONString *string, const char *data, size_t length);
+
+void resetDocument(JSONDocument *document);
+
+// Parses the children of a lazy container, its own nested containers stay lazy
+JSONError materializeNode(JSONNode *node);
+
+// JSON_PARSE_PARALLEL, falls back to parseDocumentRoot when the root is not a
+// big enough array
+JSONError parseArrayInParallel(JSONDocument *document, const char *input, size_t inputLength, uint32_t flags,
+                               uint32_t threadCount);
+
+// Parses a whole input into root, allocating in the arena of the document.
+// root is left untouched on error. projection can be NULL.
+JSONError parseDocumentRoot(JSONDocument *document, ParseScratch *scratch, const char *input, size_t inputLength,
+                            uint32_t flags, const Projection *projection, JSONNode *root);
+
+void freeNodeStack(NodeStack *stack);
+JSONError pushToNodeStack(NodeStack *stack, JSONString *key, uint32_t keyHash, JSONNode *value);
+JSONError popFromNodeStack(NodeStack *stack, Arena *arena, JSONNode *node, size_t start);
+
+// A scratch can also be zero initialized, it then allocates with malloc
+void initParseScratch(ParseScratch *scratch, const JSONAllocator *allocator);
+// Keeps the allocator, the scratch can be used again
+void freeParseScratch(ParseScratch *scratch);
+
+// Reads the string token at the current index. Strings without escapes are
+// returned in place (inInput is set), the others are decoded in the scratch
+// buffer and only valid until the next string.
+JSONError readJSONString(parseContext *ctx, const char **data, size_t *length, bool *inInput);
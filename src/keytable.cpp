@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "allocator.h"
+#include "keytable.h"
+#include "thread.h"
+#include "json.h"
+
+#define KEY_TABLE_MIN_SLOTS 16
+
+//
+// JSONKeyTable private API
+//
+
+KeyEntry* newKeyEntry(JSONKeyTable *table, const char *key, size_t keyLength, uint32_t hash)
+{
+    KeyEntry *entry = (KeyEntry *) allocMemory(&table->allocator, sizeof(KeyEntry) + keyLength + 1);
+    if (!entry)
+    {
+        return NULL;
+    }
+
+    char *data = (char *) (entry + 1);
+    memcpy(data, key, keyLength);
+    data[keyLength] = '\0';
+
+    entry->string.data = data;
+    entry->string.length = keyLength;
+    entry->hash = hash;
+
+    return entry;
+}
+
+const JSONString* internKey(JSONKeyTable *table, const char *key, size_t keyLength, uint32_t hash)
+{
+    // Allocated at the first NULL slot, kept while probing further if another
+    // thread takes that slot first
+    KeyEntry *created = NULL;
+
+    for (size_t slot = hash & table->slotMask;; slot = (slot + 1) & table->slotMask)
+    {
+        void *volatile *slotPtr = (void *volatile *) &table->slots[slot];
+        KeyEntry *entry = (KeyEntry *) atomicLoadPointer(slotPtr);
+
+        if (!entry)
+        {
+            if (!created)
+            {
+                // NOTE(vincent): a thread losing the race for the same key
+                // wastes its reservation, the table only fills up a bit sooner.
+                // Once it is full the counter is only read, so the misses of
+                // every thread do not keep writing to its cache line.
+                if (atomicLoad(&table->reservedKeys) >= table->maxKeys
+                        || atomicFetchAdd(&table->reservedKeys, 1) >= table->maxKeys)
+                {
+                    return NULL;
+                }
+
+                if (!(created = newKeyEntry(table, key, keyLength, hash)))
+                {
+                    return NULL;
+                }
+            }
+
+            if (atomicCompareExchangePointer(slotPtr, NULL, created))
+            {
+                return &created->string;
+            }
+
+            entry = (KeyEntry *) atomicLoadPointer(slotPtr);
+        }
+
+        if (entry->hash == hash && entry->string.length == keyLength
+                && memcmp(entry->string.data, key, keyLength) == 0)
+        {
+            if (created)
+            {
+                freeMemory(&table->allocator, created);
+            }
+
+            return &entry->string;
+        }
+    }
+}
+
+//
+// JSONKeyTable public API
+//
+
+JSON_API JSONKeyTable* JSONCreateKeyTable(size_t maxKeys, const JSONAllocator *allocator)
+{
+    // Up to four slots a key, past that their size overflows and so does the
+    // count below
+    if (maxKeys > SIZE_MAX / 4 / sizeof(KeyEntry *))
+    {
+        return NULL;
+    }
+
+    allocator = getAllocator(allocator);
+
+    size_t slotCount = KEY_TABLE_MIN_SLOTS;
+    while (slotCount < maxKeys * 2)
+    {
+        slotCount *= 2;
+    }
+
+    JSONKeyTable *table = (JSONKeyTable *) allocMemory(allocator, sizeof(JSONKeyTable));
+    if (!table)
+    {
+        return NULL;
+    }
+
+    table->slots = (KeyEntry *volatile *) allocZeroedMemory(allocator, sizeof(KeyEntry *) * slotCount);
+    if (!table->slots)
+    {
+        freeMemory(allocator, table);
+        return NULL;
+    }
+
+    table->slotMask = slotCount - 1;
+    table->maxKeys = maxKeys;
+    table->reservedKeys = 0;
+    table->allocator = *allocator;
+
+    return table;
+}
+
+JSON_API void JSONFreeKeyTable(JSONKeyTable *table)
+{
+    if (!table)
+    {
+        return;
+    }
+
+    for (size_t slot = 0; slot <= table->slotMask; slot++)
+    {
+        if (table->slots[slot])
+        {
+            freeMemory(&table->allocator, table->slots[slot]);
+        }
+    }
+
+    // The table holds the allocator it is freed with
+    JSONAllocator allocator = table->allocator;
+    freeMemory(&allocator, (void *) table->slots);
+    freeMemory(&allocator, table);
+}
+
+JSON_API const char* JSONKeyTableIntern(JSONKeyTable *table, const char *key, size_t keyLength)
+{
+    const JSONString *interned = internKey(table, key, keyLength, hashKey(key, keyLength));
+
+    return interned ? interned->data : NULL;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "json_private.h"
+#include "json.h"
+
+// A key of JSONKeyTable, allocated with its NUL terminated data right after it
+struct KeyEntry
+{
+    JSONString string;
+    uint32_t hash;
+};
+
+// Open addressing table of entries, never resized or emptied before it is
+// freed. Slots go from NULL to their entry once with a compare and swap, so
+// lookups only load pointers and never wait on an insert.
+struct JSONKeyTable
+{
+    KeyEntry *volatile *slots;
+    size_t slotMask; // at least twice maxKeys, probes always reach a NULL slot
+
+    size_t maxKeys;
+    volatile size_t reservedKeys; // can go past maxKeys, keys are then refused
+
+    JSONAllocator allocator;
+};
+
+// Returns the canonical copy of the key, or NULL once the table is full or out
+// of memory: the key then has to be copied as usual. hash is hashKey(key).
+const JSONString* internKey(JSONKeyTable *table, const char *key, size_t keyLength, uint32_t hash);
@@ -0,0 +1,137 @@
+#include "mapping.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+
+JSONError mapFile(FileMapping *mapping, const char *path, bool sequential)
+{
+    memset(mapping, 0, sizeof(FileMapping));
+
+    // NOTE(vincent): FILE_FLAG_SEQUENTIAL_SCAN and FILE_FLAG_RANDOM_ACCESS are
+    // the Win32 versions of the madvise hints, the cache manager reads ahead
+    // more or less.
+    DWORD access = sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | access, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t) size.QuadPart > (uint64_t) SIZE_MAX)
+    {
+        CloseHandle(file);
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    if (size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return ERR_NOERROR;
+    }
+
+    HANDLE fileMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!fileMapping)
+    {
+        CloseHandle(file);
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    const char *data = (const char *) MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(fileMapping);
+        CloseHandle(file);
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    mapping->data = data;
+    mapping->length = (size_t) size.QuadPart;
+    mapping->file = file;
+    mapping->mapping = fileMapping;
+
+    return ERR_NOERROR;
+}
+
+void unmapFile(FileMapping *mapping)
+{
+    if (mapping->data)
+    {
+        UnmapViewOfFile(mapping->data);
+        CloseHandle((HANDLE) mapping->mapping);
+        CloseHandle((HANDLE) mapping->file);
+    }
+
+    memset(mapping, 0, sizeof(FileMapping));
+}
+
+#else
+
+JSONError mapFile(FileMapping *mapping, const char *path, bool sequential)
+{
+    memset(mapping, 0, sizeof(FileMapping));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (uint64_t) info.st_size > (uint64_t) SIZE_MAX)
+    {
+        close(fd);
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    if (info.st_size == 0)
+    {
+        close(fd);
+        return ERR_NOERROR;
+    }
+
+    size_t length = (size_t) info.st_size;
+    void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        return ERR_CANNOT_READ_FILE;
+    }
+
+    // The parser reads the input front to back: the kernel reads ahead more
+    // and can drop the pages already read first. Lookups in place jump around,
+    // reading ahead would only fill the cache with pages never touched.
+    madvise(data, length, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+    mapping->data = (const char *) data;
+    mapping->length = length;
+
+    return ERR_NOERROR;
+}
+
+void unmapFile(FileMapping *mapping)
+{
+    if (mapping->data)
+    {
+        munmap((void *) mapping->data, mapping->length);
+    }
+
+    memset(mapping, 0, sizeof(FileMapping));
+}
+
+#endif
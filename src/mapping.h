@@ -0,0 +1,20 @@
+#pragma once
+
+#include "json.h"
+
+// Read only view of a whole file
+struct FileMapping
+{
+    const char *data;
+    size_t length;
+
+    // Win32 file and mapping handles, unused elsewhere
+    void *file;
+    void *mapping;
+};
+
+// Maps the file with a sequential access hint when the file is read front to
+// back, a random one otherwise. An empty file gives a NULL data pointer and a
+// length of 0.
+JSONError mapFile(FileMapping *mapping, const char *path, bool sequential);
+void unmapFile(FileMapping *mapping);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "json.h"
+
+bool isDigit(char ch);
+
+// Parses the number token starting at ptr, without reading past end. On
+// success endPtr points right after the token and type is INTEGER_NODE, with
+// intValue set, or DOUBLE_NODE, with doubleValue set. Integers which do not
+// fit in 64 bits are returned as doubles.
+JSONError parseNumberToken(const char *ptr, const char *end, const char **endPtr,
+                           JSONNodeType *type, int64_t *intValue, double *doubleValue);
+
+// Formats the value with the fewest significant digits (at most 17) which
+// read back to the same double, always with a '.' or an exponent so it is not
+// parsed back as an integer. The output does not depend on the locale. buffer
+// must hold at least 32 bytes; value must be finite. Returns the length written.
+size_t formatDouble(double value, char *buffer);
+
+// buffer must hold at least 20 bytes. Returns the length written.
+size_t formatInteger(int64_t value, char *buffer);
@@ -0,0 +1,266 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "events.h"
+#include "json_private.h"
+#include "structural.h"
+#include "thread.h"
+#include "json.h"
+
+// Smaller arrays are not worth starting threads for
+#define PARALLEL_MIN_INPUT_LENGTH (1 << 20)
+
+//
+// Parallel array private API
+//
+
+// Elements between two of the commas found by findArraySplits
+struct ArrayPart
+{
+    const char *input;
+    size_t inputLength;
+
+    JSONDocument *document;
+    uint32_t flags;
+    bool endsArray;
+
+    // Nodes go to the arena of the part, the elements themselves are left on
+    // the node stack until they are all copied in the root.
+    Arena arena;
+    ParseScratch scratch;
+    JSONError error;
+
+#if defined(JSON_STATS)
+    JSONParseStats stats; // summed in the stats of the document once joined
+#endif
+};
+
+// Shared by all the threads. Threads which cannot be started are skipped, the
+// parts are taken in turn so the ones started parse all of them.
+struct ArrayPartQueue
+{
+    ArrayPart *parts;
+    size_t partCount;
+    volatile size_t nextPart;
+};
+
+void parseArrayPart(ArrayPart *part)
+{
+    size_t index = 0;
+
+    parseContext ctx = {};
+    ctx.input = part->input;
+    ctx.inputLength = part->inputLength;
+    ctx.index = &index;
+    ctx.scratch = &part->scratch;
+    ctx.flags = part->flags;
+
+    DomBuilder builder;
+    initDomBuilder(&builder, part->document, &part->scratch, part->flags);
+    builder.arena = &part->arena;
+
+    part->error = parseArrayElements(&builder, &ctx, part->endsArray);
+}
+
+void parseArrayParts(void *userData)
+{
+    ArrayPartQueue *queue = (ArrayPartQueue *) userData;
+
+    for (;;)
+    {
+        size_t next = atomicFetchAdd(&queue->nextPart, 1);
+        if (next >= queue->partCount)
+        {
+            break;
+        }
+
+        parseArrayPart(&queue->parts[next]);
+    }
+}
+
+// Copies the elements of all the parts in the root, in order
+JSONError joinArrayParts(JSONDocument *document, ArrayPart *parts, uint32_t partCount)
+{
+    size_t count = 0;
+
+    for (uint32_t i = 0; i < partCount; i++)
+    {
+        if (parts[i].error != ERR_NOERROR)
+        {
+            return parts[i].error;
+        }
+
+        count += parts[i].scratch.stack.length;
+    }
+
+    JSONNode *root = &document->root;
+    root->type = ARRAY_NODE;
+    root->length = count;
+    root->values = (JSONNode *) arenaAlloc(&document->arena, sizeof(JSONNode) * count);
+    if (!root->values)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    JSONNode *values = root->values;
+    for (uint32_t i = 0; i < partCount; i++)
+    {
+        NodeStack *stack = &parts[i].scratch.stack;
+
+        // The last part is empty after a trailing comma
+        if (stack->length)
+        {
+            memcpy(values, stack->values, sizeof(JSONNode) * stack->length);
+            values += stack->length;
+        }
+
+        mergeArena(&document->arena, &parts[i].arena);
+    }
+
+#if defined(JSON_STATS)
+    JSONParseStats *stats = document->scratch.stats;
+    if (stats)
+    {
+        for (uint32_t i = 0; i < partCount; i++)
+        {
+            mergeParseStats(stats, &parts[i].stats);
+        }
+
+        // The parts count from inside the root array
+        stats->nodeCounts[ARRAY_NODE]++;
+        stats->maxDepth++;
+    }
+#endif
+
+    return ERR_NOERROR;
+}
+
+JSONError parseArraySequentially(JSONDocument *document, const char *input, size_t inputLength, uint32_t flags)
+{
+    return parseDocumentRoot(document, &document->scratch, input, inputLength, flags, NULL, &document->root);
+}
+
+JSONError parseArrayInParallel(JSONDocument *document, const char *input, size_t inputLength, uint32_t flags,
+                               uint32_t threadCount)
+{
+    JSONError error;
+
+    flags &= ~(uint32_t) JSON_PARSE_PARALLEL;
+
+    if (threadCount == 0)
+    {
+        threadCount = getProcessorCount();
+    }
+
+    if (threadCount < 2 || inputLength < PARALLEL_MIN_INPUT_LENGTH || input[0] != '[')
+    {
+        return parseArraySequentially(document, input, inputLength, flags);
+    }
+
+    const JSONAllocator *allocator = &document->allocator;
+
+    size_t *splits = (size_t *) allocMemory(allocator, sizeof(size_t) * (threadCount - 1));
+    if (!splits)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    size_t splitCount = 0;
+    size_t closing = 0;
+    STATS_TIMER(indexStart);
+    bool wellFormed = findArraySplits(input, inputLength, threadCount - 1, splits, &splitCount, &closing)
+        == ERR_NOERROR;
+    STATS_ADD_ELAPSED(document->scratch.stats, indexNanoseconds, indexStart);
+
+    // Only whitespace may follow the root
+    for (size_t i = closing + 1; wellFormed && i < inputLength; i++)
+    {
+        char ch = input[i];
+        wellFormed = ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+    }
+
+    // NOTE(vincent): a few big elements leave nothing to share. Broken inputs
+    // go to the sequential parser too, so they fail with the error it gives
+    // whatever the input length or thread count.
+    if (!wellFormed || splitCount == 0)
+    {
+        freeMemory(allocator, splits);
+        return parseArraySequentially(document, input, inputLength, flags);
+    }
+
+    uint32_t partCount = (uint32_t) splitCount + 1;
+    ArrayPart *parts = (ArrayPart *) allocZeroedMemory(allocator, sizeof(ArrayPart) * partCount);
+    void **partData = (void **) allocZeroedMemory(allocator, sizeof(void *) * partCount);
+    if (!parts || !partData)
+    {
+        freeMemory(allocator, splits);
+        freeMemory(allocator, parts);
+        freeMemory(allocator, partData);
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    // The structural index is built per input, the parts go without it
+    uint32_t partFlags = flags & ~(uint32_t) JSON_PARSE_STRUCTURAL_INDEX;
+
+    for (uint32_t i = 0; i < partCount; i++)
+    {
+        size_t begin = i == 0 ? 1 : splits[i - 1] + 1;
+        size_t end = i == partCount - 1 ? closing : splits[i];
+
+        parts[i].input = input + begin;
+        parts[i].inputLength = end - begin;
+        parts[i].document = document;
+        parts[i].flags = partFlags;
+        parts[i].endsArray = i == partCount - 1;
+        initArena(&parts[i].arena, allocator);
+        initParseScratch(&parts[i].scratch, allocator);
+
+#if defined(JSON_STATS)
+        parts[i].scratch.stats = document->scratch.stats ? &parts[i].stats : NULL;
+#endif
+    }
+
+    ArrayPartQueue queue;
+    queue.parts = parts;
+    queue.partCount = partCount;
+    queue.nextPart = 0;
+
+    for (uint32_t i = 0; i < partCount; i++)
+    {
+        partData[i] = &queue;
+    }
+
+    runOnThreads(partCount, parseArrayParts, partData, allocator);
+
+    // NOTE(vincent): the parts bring their own chunks, the ones kept from the
+    // previous parse would only pile up in front of them.
+    freeArena(&document->arena);
+
+    error = joinArrayParts(document, parts, partCount);
+
+    for (uint32_t i = 0; i < partCount; i++)
+    {
+        freeArena(&parts[i].arena);
+        freeParseScratch(&parts[i].scratch);
+    }
+
+    freeMemory(allocator, splits);
+    freeMemory(allocator, parts);
+    freeMemory(allocator, partData);
+
+    if (error != ERR_NOERROR)
+    {
+        resetDocument(document);
+    }
+
+    // A part only sees its own elements, a value cut short by its end is
+    // ERR_EOF where the whole input would show the next character. The first
+    // error is found again in order, the one of the sequential parser.
+    if (error != ERR_NOERROR && error != ERR_OUT_OF_MEMORY)
+    {
+        return parseArraySequentially(document, input, inputLength, flags);
+    }
+
+    return error;
+}
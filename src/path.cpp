@@ -0,0 +1,347 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "json_private.h"
+#include "path.h"
+#include "tape.h"
+#include "json.h"
+
+// Tokens longer than this are never array indices, they would not fit
+#define PATH_MAX_INDEX_DIGITS 18
+
+//
+// JSONPath private API
+//
+
+struct PathResults
+{
+    JSONNode **nodes;
+    size_t capacity;
+    size_t count;
+};
+
+// RFC 6901 indices are decimal without leading zeros, "-" is past the end of
+// the array and never matches anything
+size_t parseArrayIndex(const char *token, size_t length)
+{
+    if (length == 0 || length > PATH_MAX_INDEX_DIGITS || (token[0] == '0' && length > 1))
+    {
+        return PATH_NO_INDEX;
+    }
+
+    size_t index = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (token[i] < '0' || token[i] > '9')
+        {
+            return PATH_NO_INDEX;
+        }
+
+        index = index * 10 + (size_t) (token[i] - '0');
+    }
+
+    return index;
+}
+
+// Copies the token to keys with ~0 and ~1 replaced, returns the length written
+// or -1 when a '~' is not followed by one of them
+int64_t unescapeToken(const char *token, size_t length, char *keys)
+{
+    size_t written = 0;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        char ch = token[i];
+
+        if (ch == '~')
+        {
+            if (i + 1 == length || (token[i + 1] != '0' && token[i + 1] != '1'))
+            {
+                return -1;
+            }
+
+            ch = token[++i] == '0' ? '~' : '/';
+        }
+
+        keys[written++] = ch;
+    }
+
+    keys[written] = '\0';
+
+    return (int64_t) written;
+}
+
+// The node must not be lazy anymore
+JSONNode* getArrayElement(JSONNode *node, size_t index)
+{
+    if (isTapePointer(node))
+    {
+        const uint64_t *word = getTapeWord(node) + 1;
+
+        for (; getTapeTag(*word) != TAPE_ARRAY_END; index--)
+        {
+            if (index == 0)
+            {
+                return makeTapeNode(word);
+            }
+
+            word = skipTapeValue(word);
+        }
+
+        return NULL;
+    }
+
+    return index < node->length ? &node->values[index] : NULL;
+}
+
+JSONError addPathResult(PathResults *results, JSONNode *node)
+{
+    if (results->count == results->capacity)
+    {
+        return ERR_OUTPUT_BUFFER_TOO_SMALL;
+    }
+
+    results->nodes[results->count++] = node;
+
+    return ERR_NOERROR;
+}
+
+// Follows the steps from `step` on below node. Only wildcards branch, so the
+// recursion is as deep as the path is long.
+JSONError evalPathSteps(const PathStep *step, const PathStep *end, JSONNode *node, PathResults *results)
+{
+    JSONError error;
+
+    for (; step < end; step++)
+    {
+        JSONNodeType type = JSONGetNodeType(node);
+        if (type != OBJECT_NODE && type != ARRAY_NODE)
+        {
+            return ERR_NOERROR;
+        }
+
+        // Syntax errors of lazy containers are reported instead of looking
+        // like a missing key
+        if (!isTapePointer(node) && node->lazy && (error = materializeNode(node)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        if (step->wildcard)
+        {
+            JSONIterator iter;
+            initIterator(&iter, node);
+
+            JSONString *key;
+            JSONNode *value;
+            while ((error = JSONIteratorGetNext(&iter, &key, &value)) == ERR_NOERROR)
+            {
+                if ((error = evalPathSteps(step + 1, end, value, results)) != ERR_NOERROR)
+                {
+                    return error;
+                }
+            }
+
+            return error == ERR_ITERATOR_NO_MORE_ELEMENTS ? ERR_NOERROR : error;
+        }
+
+        if (type == OBJECT_NODE)
+        {
+            node = objectGetWithHash(node, step->key, step->keyLength, step->keyHash);
+        }
+        else
+        {
+            node = step->index != PATH_NO_INDEX ? getArrayElement(node, step->index) : NULL;
+        }
+
+        if (!node)
+        {
+            return ERR_NOERROR;
+        }
+    }
+
+    return addPathResult(results, node);
+}
+
+JSONError initProjection(Projection *projection, JSONPath *const *paths, size_t count)
+{
+    if (count > PROJECTION_MAX_PATHS || (count && !paths))
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!paths[i])
+        {
+            return ERR_INVALID_ARGUMENT;
+        }
+    }
+
+    projection->paths = paths;
+    projection->count = count;
+    projection->rootMask = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (paths[i]->stepCount == 0)
+        {
+            projection->rootMask = 0;
+            break;
+        }
+
+        projection->rootMask |= 1ULL << i;
+    }
+
+    return ERR_NOERROR;
+}
+
+uint64_t matchProjection(const Projection *projection, uint64_t mask, size_t depth, const char *key,
+                         size_t keyLength, size_t index)
+{
+    uint64_t matched = 0;
+
+    for (size_t i = 0; i < projection->count; i++)
+    {
+        if (!(mask & (1ULL << i)))
+        {
+            continue;
+        }
+
+        const PathStep *step = &projection->paths[i]->steps[depth];
+
+        bool matches;
+        if (step->wildcard)
+        {
+            matches = true;
+        }
+        else if (key)
+        {
+            matches = step->keyLength == keyLength && memcmp(step->key, key, keyLength) == 0;
+        }
+        else
+        {
+            matches = step->index == index;
+        }
+
+        if (matches)
+        {
+            matched |= 1ULL << i;
+        }
+    }
+
+    return matched;
+}
+
+bool endsProjection(const Projection *projection, uint64_t mask, size_t depth)
+{
+    for (size_t i = 0; i < projection->count; i++)
+    {
+        if ((mask & (1ULL << i)) && projection->paths[i]->stepCount == depth + 1)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//
+// JSONPath public API
+//
+
+JSON_API JSONError JSONPathCompile(const char *pointer, size_t pointerLength, const JSONAllocator *allocator,
+                                   JSONPath **path)
+{
+    *path = NULL;
+
+    if (pointerLength > 0 && pointer[0] != '/')
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    size_t stepCount = 0;
+    for (size_t i = 0; i < pointerLength; i++)
+    {
+        stepCount += pointer[i] == '/';
+    }
+
+    // Unescaping only shrinks the tokens, each of them gets room for a NUL
+    allocator = getAllocator(allocator);
+    size_t size = sizeof(JSONPath) + sizeof(PathStep) * stepCount + pointerLength + 1;
+
+    JSONPath *compiled = (JSONPath *) allocMemory(allocator, size);
+    if (!compiled)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    compiled->steps = (PathStep *) (compiled + 1);
+    compiled->stepCount = stepCount;
+    compiled->allocator = *allocator;
+
+    char *keys = (char *) (compiled->steps + stepCount);
+    const char *end = pointer + pointerLength;
+    const char *token = pointer + 1;
+
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        const char *tokenEnd = (const char *) memchr(token, '/', (size_t) (end - token));
+        if (!tokenEnd)
+        {
+            tokenEnd = end;
+        }
+
+        size_t tokenLength = (size_t) (tokenEnd - token);
+        int64_t keyLength = unescapeToken(token, tokenLength, keys);
+        if (keyLength < 0)
+        {
+            freeMemory(allocator, compiled);
+            return ERR_INVALID_ARGUMENT;
+        }
+
+        PathStep *step = &compiled->steps[i];
+        step->key = keys;
+        step->keyLength = (size_t) keyLength;
+        step->keyHash = hashKey(keys, step->keyLength);
+        step->index = parseArrayIndex(token, tokenLength);
+        step->wildcard = tokenLength == 1 && token[0] == '*';
+
+        keys += keyLength + 1;
+        token = tokenEnd + 1;
+    }
+
+    *path = compiled;
+
+    return ERR_NOERROR;
+}
+
+JSON_API void JSONFreePath(JSONPath *path)
+{
+    if (!path)
+    {
+        return;
+    }
+
+    // The path holds the allocator it is freed with
+    JSONAllocator allocator = path->allocator;
+    freeMemory(&allocator, path);
+}
+
+JSON_API JSONError JSONPathEval(JSONPath *path, JSONNode *node, JSONNode **results, size_t capacity, size_t *count)
+{
+    PathResults found = {};
+    found.nodes = results;
+    found.capacity = capacity;
+
+    JSONError error = ERR_NOERROR;
+    if (node)
+    {
+        error = evalPathSteps(path->steps, path->steps + path->stepCount, node, &found);
+    }
+
+    *count = found.count;
+
+    return error;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "json.h"
+
+// Projections are followed with one bit per path
+#define PROJECTION_MAX_PATHS 64
+
+#define PATH_NO_INDEX ((size_t) -1)
+
+// A reference token of the pointer, with everything evaluation needs computed
+// once at compile time
+struct PathStep
+{
+    const char *key; // unescaped, NUL terminated in the storage of the path
+    size_t keyLength;
+    uint32_t keyHash;
+
+    size_t index; // PATH_NO_INDEX unless the token is an array index
+    bool wildcard;
+};
+
+// Allocated at once with its steps, followed by the unescaped keys
+struct JSONPath
+{
+    PathStep *steps;
+    size_t stepCount;
+
+    JSONAllocator allocator;
+};
+
+// The paths of JSONParseOptions::projection while parsing. Each step matches
+// one level of nesting, so the paths still matching the container being
+// parsed fit in a mask with a bit per path.
+struct Projection
+{
+    JSONPath *const *paths;
+    size_t count;
+
+    uint64_t rootMask; // 0 when a path keeps the whole document
+};
+
+// Returns ERR_INVALID_ARGUMENT for more than PROJECTION_MAX_PATHS paths or a
+// NULL one
+JSONError initProjection(Projection *projection, JSONPath *const *paths, size_t count);
+
+// Returns the paths of mask whose step at depth matches the member key, or the
+// element index when key is NULL
+uint64_t matchProjection(const Projection *projection, uint64_t mask, size_t depth, const char *key,
+                         size_t keyLength, size_t index);
+
+// Whether one of the paths of mask ends with its step at depth, the value it
+// matched is then kept whole
+bool endsProjection(const Projection *projection, uint64_t mask, size_t depth);
@@ -0,0 +1,108 @@
+#include "stats.h"
+
+#if defined(JSON_STATS)
+
+#include "allocator.h"
+#include "thread.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//
+// Stats private API
+//
+
+#if defined(_WIN32)
+
+uint64_t getStatsTime()
+{
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    // Split so the multiplication does not overflow after a few hours
+    uint64_t seconds = (uint64_t) counter.QuadPart / (uint64_t) frequency.QuadPart;
+    uint64_t remainder = (uint64_t) counter.QuadPart % (uint64_t) frequency.QuadPart;
+
+    return seconds * 1000000000ULL + remainder * 1000000000ULL / (uint64_t) frequency.QuadPart;
+}
+
+#else
+
+uint64_t getStatsTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+#endif
+
+void countAllocation(StatsAllocator *counting, size_t size)
+{
+    atomicFetchAdd((volatile size_t *) &counting->stats->allocationCount, 1);
+    atomicFetchAdd((volatile size_t *) &counting->stats->allocationBytes, size);
+}
+
+void* statsAlloc(void *userData, size_t size)
+{
+    StatsAllocator *counting = (StatsAllocator *) userData;
+    countAllocation(counting, size);
+
+    return counting->replaced.alloc(counting->replaced.userData, size);
+}
+
+void* statsRealloc(void *userData, void *ptr, size_t size)
+{
+    StatsAllocator *counting = (StatsAllocator *) userData;
+    countAllocation(counting, size);
+
+    return counting->replaced.realloc(counting->replaced.userData, ptr, size);
+}
+
+void statsFree(void *userData, void *ptr)
+{
+    StatsAllocator *counting = (StatsAllocator *) userData;
+
+    counting->replaced.free(counting->replaced.userData, ptr);
+}
+
+void startAllocationStats(StatsAllocator *counting, JSONAllocator *allocator, JSONParseStats *stats)
+{
+    counting->replaced = *allocator;
+    counting->stats = stats;
+
+    allocator->alloc = statsAlloc;
+    allocator->realloc = statsRealloc;
+    allocator->free = statsFree;
+    allocator->userData = counting;
+}
+
+void stopAllocationStats(StatsAllocator *counting, JSONAllocator *allocator)
+{
+    *allocator = counting->replaced;
+}
+
+void mergeParseStats(JSONParseStats *stats, const JSONParseStats *part)
+{
+    for (size_t i = 0; i <= NULL_NODE; i++)
+    {
+        stats->nodeCounts[i] += part->nodeCounts[i];
+    }
+
+    if (stats->maxDepth < part->maxDepth)
+    {
+        stats->maxDepth = part->maxDepth;
+    }
+
+    stats->stringBytesCopied += part->stringBytesCopied;
+    stats->stringBytesViewed += part->stringBytesViewed;
+}
+
+#endif
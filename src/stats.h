@@ -0,0 +1,75 @@
+#pragma once
+
+#include "json.h"
+
+// JSONParseStats are only counted when the library is built with JSON_STATS,
+// without it the macros below expand to nothing and the parsers carry no trace
+// of them.
+
+#if defined(JSON_STATS)
+
+// Monotonic clock in nanoseconds
+uint64_t getStatsTime();
+
+// Stands in for the allocator of a document or scratch during a parse,
+// counting what goes through before forwarding to the real one. The counters
+// are updated atomically, the parallel parts allocate concurrently.
+struct StatsAllocator
+{
+    JSONAllocator replaced;
+    JSONParseStats *stats;
+};
+
+// The allocator pointed to is swapped with a counting one until
+// stopAllocationStats puts it back, so everything already holding a pointer
+// to it is counted too.
+void startAllocationStats(StatsAllocator *counting, JSONAllocator *allocator, JSONParseStats *stats);
+void stopAllocationStats(StatsAllocator *counting, JSONAllocator *allocator);
+
+// Sums the counts of a parallel part in the stats of the whole document
+void mergeParseStats(JSONParseStats *stats, const JSONParseStats *part);
+
+#define STATS_ADD(stats, field, value) do { if (stats) (stats)->field += (value); } while (0)
+#define STATS_TIMER(name) uint64_t name = getStatsTime()
+#define STATS_ADD_ELAPSED(stats, field, timer) STATS_ADD(stats, field, getStatsTime() - (timer))
+
+#define STATS_COUNT_NODE(ctx, type) STATS_ADD((ctx)->scratch->stats, nodeCounts[type], 1)
+
+// Strings without escapes are viewed when the flags ask for it
+#define STATS_COUNT_STRING(ctx, length, inInput)                                                     \
+    do                                                                                               \
+    {                                                                                                \
+        if ((inInput) && ((ctx)->flags & JSON_PARSE_VIEW_STRINGS))                                   \
+        {                                                                                            \
+            STATS_ADD((ctx)->scratch->stats, stringBytesViewed, length);                             \
+        }                                                                                            \
+        else                                                                                         \
+        {                                                                                            \
+            STATS_ADD((ctx)->scratch->stats, stringBytesCopied, length);                             \
+        }                                                                                            \
+    } while (0)
+
+#define STATS_ENTER_CONTAINER(ctx)                                                                   \
+    do                                                                                               \
+    {                                                                                                \
+        JSONParseStats *enteredStats = (ctx)->scratch->stats;                                        \
+        (ctx)->depth++;                                                                              \
+        if (enteredStats && enteredStats->maxDepth < (ctx)->depth)                                   \
+        {                                                                                            \
+            enteredStats->maxDepth = (ctx)->depth;                                                   \
+        }                                                                                            \
+    } while (0)
+
+#define STATS_LEAVE_CONTAINER(ctx) ((ctx)->depth--)
+
+#else
+
+#define STATS_ADD(stats, field, value) ((void) 0)
+#define STATS_TIMER(name) ((void) 0)
+#define STATS_ADD_ELAPSED(stats, field, timer) ((void) 0)
+#define STATS_COUNT_NODE(ctx, type) ((void) 0)
+#define STATS_COUNT_STRING(ctx, length, inInput) ((void) 0)
+#define STATS_ENTER_CONTAINER(ctx) ((void) 0)
+#define STATS_LEAVE_CONTAINER(ctx) ((void) 0)
+
+#endif
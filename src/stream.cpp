@@ -0,0 +1,623 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "events.h"
+#include "json_private.h"
+#include "number.h"
+#include "json.h"
+
+//
+// JSONParser private API
+//
+
+enum StreamState
+{
+    STREAM_EXPECT_ROOT,
+    STREAM_EXPECT_VALUE,            // after ':' or after ',' in an array
+    STREAM_EXPECT_VALUE_OR_END,     // after '['
+    STREAM_EXPECT_KEY,              // after ',' in an object
+    STREAM_EXPECT_KEY_OR_END,       // after '{'
+    STREAM_EXPECT_COLON,
+    STREAM_EXPECT_COMMA_OR_END,
+    STREAM_DONE
+};
+
+enum StreamToken
+{
+    STREAM_TOKEN_NONE,
+    STREAM_TOKEN_STRING,
+    STREAM_TOKEN_NUMBER,
+    STREAM_TOKEN_LITERAL // true, false or null
+};
+
+struct JSONParser
+{
+    uint32_t flags;
+    JSONError error;
+
+    StreamState state;
+    ParseScratch scratch;
+
+    // Types of the containers opened and not closed yet
+    JSONNodeType *containers;
+    size_t depth;
+    size_t containerCapacity;
+
+    // Token split across chunks, its beginning is accumulated in the buffer
+    StreamToken token;
+    Buffer *tokenBuffer;
+    bool escapePending; // the buffered string ends with an unescaped backslash
+
+    // The content goes to the builder when there is a document, to the events
+    // otherwise
+    JSONDocument *document;
+    DomBuilder builder;
+    EventHandler events;
+
+    JSONAllocator allocator;
+};
+
+bool isWhitespace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+bool isNumberChar(char ch)
+{
+    return isDigit(ch) || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+}
+
+bool isLiteralChar(char ch)
+{
+    return ch >= 'a' && ch <= 'z';
+}
+
+// Returns the end of the token starting (or continuing) at ptr, or NULL if it
+// goes past the end of the chunk. For strings the end is right after the
+// closing quote.
+const char* findTokenEnd(JSONParser *parser, StreamToken token, const char *ptr, const char *end)
+{
+    if (token == STREAM_TOKEN_STRING)
+    {
+        for (; ptr < end; ptr++)
+        {
+            if (parser->escapePending)
+            {
+                parser->escapePending = false;
+            }
+            else if (*ptr == '\\')
+            {
+                parser->escapePending = true;
+            }
+            else if (*ptr == '"')
+            {
+                return ptr + 1;
+            }
+        }
+
+        return NULL;
+    }
+
+    bool (*isTokenChar)(char) = token == STREAM_TOKEN_NUMBER ? isNumberChar : isLiteralChar;
+    for (; ptr < end; ptr++)
+    {
+        if (!isTokenChar(*ptr))
+        {
+            return ptr;
+        }
+    }
+
+    return NULL;
+}
+
+// Called once a value is complete, containers included
+void endStreamValue(JSONParser *parser)
+{
+    parser->state = parser->depth == 0 ? STREAM_DONE : STREAM_EXPECT_COMMA_OR_END;
+}
+
+template <typename Handler>
+JSONError openStreamContainer(JSONParser *parser, Handler *handler, JSONNodeType type)
+{
+    if (parser->depth == parser->containerCapacity)
+    {
+        size_t newCapacity = parser->containerCapacity ? parser->containerCapacity * 2 : 32;
+
+        JSONNodeType *containers = (JSONNodeType *) reallocMemory(&parser->allocator, parser->containers, sizeof(JSONNodeType) * newCapacity);
+        if (!containers)
+        {
+            return ERR_OUT_OF_MEMORY;
+        }
+
+        parser->containers = containers;
+        parser->containerCapacity = newCapacity;
+    }
+
+    parser->containers[parser->depth++] = type;
+    parser->state = type == OBJECT_NODE ? STREAM_EXPECT_KEY_OR_END : STREAM_EXPECT_VALUE_OR_END;
+
+    return emitStartContainer(handler, type);
+}
+
+template <typename Handler>
+JSONError closeStreamContainer(JSONParser *parser, Handler *handler, char ch)
+{
+    JSONError error;
+    JSONNodeType type = parser->containers[parser->depth - 1];
+
+    if (type == OBJECT_NODE && ch != '}')
+    {
+        return ERR_INVALID_OBJECT_SYNTAX;
+    }
+
+    if (type == ARRAY_NODE && ch != ']')
+    {
+        return ERR_INVALID_ARRAY_SYNTAX;
+    }
+
+    parser->depth--;
+
+    if ((error = emitEndContainer(handler, type)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    endStreamValue(parser);
+
+    return ERR_NOERROR;
+}
+
+// Decodes a complete token held contiguously in [data, data + length)
+template <typename Handler>
+JSONError completeStreamToken(JSONParser *parser, Handler *handler, StreamToken token,
+                              const char *data, size_t length)
+{
+    JSONError error;
+
+    switch (token)
+    {
+        case STREAM_TOKEN_STRING:
+        {
+            size_t index = 0;
+
+            parseContext ctx = {};
+            ctx.input = data;
+            ctx.inputLength = length;
+            ctx.index = &index;
+            ctx.scratch = &parser->scratch;
+            ctx.flags = parser->flags;
+
+            const char *string;
+            size_t stringLength;
+            bool inInput;
+
+            if ((error = readJSONString(&ctx, &string, &stringLength, &inInput)) != ERR_NOERROR)
+            {
+                return error;
+            }
+
+            if (index != length)
+            {
+                return ERR_INVALID_STRING;
+            }
+
+            if (parser->state == STREAM_EXPECT_KEY || parser->state == STREAM_EXPECT_KEY_OR_END)
+            {
+                parser->state = STREAM_EXPECT_COLON;
+
+                return emitKey(handler, string, stringLength, inInput);
+            }
+
+            error = emitString(handler, string, stringLength, inInput);
+            break;
+        }
+        case STREAM_TOKEN_NUMBER:
+        {
+            const char *end;
+            JSONNodeType type;
+            int64_t intValue = 0;
+            double doubleValue = 0.0;
+
+            if ((error = parseNumberToken(data, data + length, &end, &type,
+                                          &intValue, &doubleValue)) != ERR_NOERROR)
+            {
+                return error;
+            }
+
+            if (end != data + length)
+            {
+                return ERR_INVALID_FLOAT_SYNTAX;
+            }
+
+            if (type == DOUBLE_NODE)
+            {
+                error = emitDouble(handler, doubleValue);
+            }
+            else
+            {
+                error = emitInteger(handler, intValue);
+            }
+
+            break;
+        }
+        case STREAM_TOKEN_LITERAL:
+        {
+            if (length == 4 && memcmp(data, "true", 4) == 0)
+            {
+                error = emitBoolean(handler, true);
+            }
+            else if (length == 5 && memcmp(data, "false", 5) == 0)
+            {
+                error = emitBoolean(handler, false);
+            }
+            else if (length == 4 && memcmp(data, "null", 4) == 0)
+            {
+                error = emitNull(handler);
+            }
+            else
+            {
+                return data[0] == 'n' ? ERR_INVALID_NULL_SYNTAX : ERR_INVALID_BOOLEAN_SYNTAX;
+            }
+
+            break;
+        }
+        default:
+        {
+            return ERR_INVALID_TREE_SYNTAX;
+        }
+    }
+
+    if (error != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    endStreamValue(parser);
+
+    return ERR_NOERROR;
+}
+
+// Scans the token starting at ptr. A token ending inside the chunk is decoded
+// in place, otherwise its beginning is buffered until the next chunk.
+template <typename Handler>
+JSONError startStreamToken(JSONParser *parser, Handler *handler, StreamToken token, const char **ptr, const char *end)
+{
+    const char *start = *ptr;
+    const char *tokenEnd = findTokenEnd(parser, token, token == STREAM_TOKEN_STRING ? start + 1 : start, end);
+
+    if (!tokenEnd)
+    {
+        // Only the partial token is kept, never the chunk
+        clearBuffer(parser->tokenBuffer);
+        parser->token = token;
+        *ptr = end;
+
+        return putArrayToBuffer(parser->tokenBuffer, start, (size_t) (end - start));
+    }
+
+    *ptr = tokenEnd;
+
+    return completeStreamToken(parser, handler, token, start, (size_t) (tokenEnd - start));
+}
+
+// Continues the token buffered by the previous chunks
+template <typename Handler>
+JSONError continueStreamToken(JSONParser *parser, Handler *handler, const char **ptr, const char *end)
+{
+    JSONError error;
+    const char *start = *ptr;
+    const char *tokenEnd = findTokenEnd(parser, parser->token, start, end);
+
+    const char *chunkEnd = tokenEnd ? tokenEnd : end;
+    if ((error = putArrayToBuffer(parser->tokenBuffer, start, (size_t) (chunkEnd - start))) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    *ptr = chunkEnd;
+
+    if (!tokenEnd)
+    {
+        return ERR_NOERROR;
+    }
+
+    StreamToken token = parser->token;
+    parser->token = STREAM_TOKEN_NONE;
+
+    return completeStreamToken(parser, handler, token, parser->tokenBuffer->underlying, parser->tokenBuffer->index);
+}
+
+template <typename Handler>
+JSONError startStreamValue(JSONParser *parser, Handler *handler, const char **ptr, const char *end)
+{
+    char ch = **ptr;
+
+    if (ch == '{' || ch == '[')
+    {
+        (*ptr)++;
+
+        return openStreamContainer(parser, handler, ch == '{' ? OBJECT_NODE : ARRAY_NODE);
+    }
+
+    if (ch == '"')
+    {
+        return startStreamToken(parser, handler, STREAM_TOKEN_STRING, ptr, end);
+    }
+
+    if (isDigit(ch) || ch == '-')
+    {
+        return startStreamToken(parser, handler, STREAM_TOKEN_NUMBER, ptr, end);
+    }
+
+    if (ch == 't' || ch == 'f' || ch == 'n')
+    {
+        return startStreamToken(parser, handler, STREAM_TOKEN_LITERAL, ptr, end);
+    }
+
+    return ERR_INVALID_TREE_SYNTAX;
+}
+
+template <typename Handler>
+JSONError feedStream(JSONParser *parser, Handler *handler, const char *ptr, const char *end)
+{
+    JSONError error;
+
+    if (parser->token != STREAM_TOKEN_NONE)
+    {
+        if ((error = continueStreamToken(parser, handler, &ptr, end)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    while (ptr < end)
+    {
+        char ch = *ptr;
+
+        if (isWhitespace(ch))
+        {
+            ptr++;
+            continue;
+        }
+
+        switch (parser->state)
+        {
+            case STREAM_EXPECT_ROOT:
+            {
+                if (ch != '{' && ch != '[')
+                {
+                    return ERR_INVALID_TREE_SYNTAX;
+                }
+
+                error = startStreamValue(parser, handler, &ptr, end);
+                break;
+            }
+            case STREAM_EXPECT_VALUE_OR_END:
+            case STREAM_EXPECT_KEY_OR_END:
+            {
+                if (ch == '}' || ch == ']')
+                {
+                    ptr++;
+                    error = closeStreamContainer(parser, handler, ch);
+                    break;
+                }
+
+                if (parser->state == STREAM_EXPECT_KEY_OR_END)
+                {
+                    if (ch != '"')
+                    {
+                        return ERR_INVALID_OBJECT_SYNTAX;
+                    }
+
+                    error = startStreamToken(parser, handler, STREAM_TOKEN_STRING, &ptr, end);
+                    break;
+                }
+
+                error = startStreamValue(parser, handler, &ptr, end);
+                break;
+            }
+            case STREAM_EXPECT_VALUE:
+            {
+                error = startStreamValue(parser, handler, &ptr, end);
+                break;
+            }
+            case STREAM_EXPECT_KEY:
+            {
+                if (ch != '"')
+                {
+                    return ERR_INVALID_OBJECT_SYNTAX;
+                }
+
+                error = startStreamToken(parser, handler, STREAM_TOKEN_STRING, &ptr, end);
+                break;
+            }
+            case STREAM_EXPECT_COLON:
+            {
+                if (ch != ':')
+                {
+                    return ERR_INVALID_OBJECT_SYNTAX;
+                }
+
+                ptr++;
+                parser->state = STREAM_EXPECT_VALUE;
+                error = ERR_NOERROR;
+                break;
+            }
+            case STREAM_EXPECT_COMMA_OR_END:
+            {
+                ptr++;
+
+                if (ch == ',')
+                {
+                    bool inObject = parser->containers[parser->depth - 1] == OBJECT_NODE;
+                    parser->state = inObject ? STREAM_EXPECT_KEY : STREAM_EXPECT_VALUE;
+                    error = ERR_NOERROR;
+                    break;
+                }
+
+                error = closeStreamContainer(parser, handler, ch);
+                break;
+            }
+            default:
+            {
+                // Only whitespace may follow the root
+                return ERR_INVALID_TREE_SYNTAX;
+            }
+        }
+
+        if (error != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    return ERR_NOERROR;
+}
+
+//
+// JSONParser public API
+//
+
+JSONParser* newParser(const JSONParseOptions *options)
+{
+    const JSONAllocator *allocator = getAllocator(options ? options->allocator : NULL);
+
+    JSONParser *parser = (JSONParser *) allocMemory(allocator, sizeof(JSONParser));
+    if (!parser)
+    {
+        return NULL;
+    }
+
+    memset(parser, 0, sizeof(JSONParser));
+    parser->allocator = *allocator;
+    initParseScratch(&parser->scratch, &parser->allocator);
+
+    parser->tokenBuffer = newBuffer(&parser->allocator);
+    if (!parser->tokenBuffer)
+    {
+        freeMemory(allocator, parser);
+        return NULL;
+    }
+
+    // NOTE(vincent): chunks are gone once fed, nothing can point into them
+    uint32_t flags = options ? options->flags : (uint32_t) JSON_PARSE_DEFAULT;
+    parser->flags = flags & ~(uint32_t) (JSON_PARSE_VIEW_STRINGS | JSON_PARSE_LAZY);
+    parser->state = STREAM_EXPECT_ROOT;
+
+    return parser;
+}
+
+JSON_API JSONParser* JSONCreateParser(JSONDocument *document, const JSONParseOptions *options)
+{
+    if (!document)
+    {
+        return NULL;
+    }
+
+    JSONParser *parser = newParser(options);
+    if (!parser)
+    {
+        return NULL;
+    }
+
+    resetDocument(document);
+    document->keyTable = options ? options->keyTable : NULL;
+    parser->document = document;
+    initDomBuilder(&parser->builder, document, &parser->scratch, parser->flags);
+
+    return parser;
+}
+
+JSON_API JSONParser* JSONCreateEventParser(const JSONHandler *handler, void *userData,
+                                           const JSONParseOptions *options)
+{
+    if (!handler)
+    {
+        return NULL;
+    }
+
+    JSONParser *parser = newParser(options);
+    if (!parser)
+    {
+        return NULL;
+    }
+
+    parser->events.handler = handler;
+    parser->events.userData = userData;
+
+    return parser;
+}
+
+JSON_API void JSONFreeParser(JSONParser *parser)
+{
+    if (!parser)
+    {
+        return;
+    }
+
+    freeParseScratch(&parser->scratch);
+    freeBuffer(parser->tokenBuffer);
+    freeMemory(&parser->allocator, parser->containers);
+
+    JSONAllocator allocator = parser->allocator;
+    freeMemory(&allocator, parser);
+}
+
+JSON_API void JSONParserReset(JSONParser *parser)
+{
+    parser->error = ERR_NOERROR;
+    parser->state = STREAM_EXPECT_ROOT;
+    parser->depth = 0;
+    parser->token = STREAM_TOKEN_NONE;
+    parser->escapePending = false;
+    clearBuffer(parser->tokenBuffer);
+
+    if (parser->document)
+    {
+        resetDocument(parser->document);
+        initDomBuilder(&parser->builder, parser->document, &parser->scratch, parser->flags);
+    }
+}
+
+JSON_API JSONError JSONParserFeed(JSONParser *parser, const char *chunk, size_t length)
+{
+    if (parser->error != ERR_NOERROR)
+    {
+        return parser->error;
+    }
+
+    if (!parser->document)
+    {
+        parser->error = feedStream(parser, &parser->events, chunk, chunk + length);
+        return parser->error;
+    }
+
+    parser->error = feedStream(parser, &parser->builder, chunk, chunk + length);
+    if (parser->error == ERR_NOERROR && parser->state == STREAM_DONE)
+    {
+        parser->document->root = parser->builder.root;
+    }
+
+    return parser->error;
+}
+
+JSON_API JSONError JSONParserFinish(JSONParser *parser)
+{
+    if (parser->error != ERR_NOERROR)
+    {
+        return parser->error;
+    }
+
+    if (parser->state != STREAM_DONE)
+    {
+        return ERR_EOF;
+    }
+
+    return ERR_NOERROR;
+}
+
+JSON_API bool JSONParserIsComplete(JSONParser *parser)
+{
+    return parser->error == ERR_NOERROR && parser->state == STREAM_DONE;
+}
@@ -0,0 +1,422 @@
+#include "structural.h"
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(JSON_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define JSON_SIMD_X64
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+//
+// Block classification
+//
+
+struct BlockMasks
+{
+    uint64_t backslash;
+    uint64_t quote;
+    uint64_t whitespace;
+    uint64_t op; // { } [ ] : ,
+};
+
+typedef void (*ClassifyBlockFunc)(const char *block, BlockMasks *masks);
+
+void classifyBlockScalar(const char *block, BlockMasks *masks)
+{
+    memset(masks, 0, sizeof(BlockMasks));
+
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t bit = 1ULL << i;
+
+        switch (block[i])
+        {
+            case ' ': case '\t': case '\n': case '\r':
+                masks->whitespace |= bit;
+                break;
+            case '{': case '}': case '[': case ']': case ':': case ',':
+                masks->op |= bit;
+                break;
+            case '"':
+                masks->quote |= bit;
+                break;
+            case '\\':
+                masks->backslash |= bit;
+                break;
+        }
+    }
+}
+
+#if defined(JSON_SIMD_X64)
+
+// NOTE(vincent): '{' and '[' (and '}' and ']') only differ by 0x20, so or-ing
+// it in lets a single comparison match both brackets.
+
+void classifyBlockSSE2(const char *block, BlockMasks *masks)
+{
+    memset(masks, 0, sizeof(BlockMasks));
+
+    for (int i = 0; i < 4; i++)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *) (block + i * 16));
+        __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+
+        __m128i ws = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+        __m128i op = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+            _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+
+        int shift = i * 16;
+        masks->whitespace |= (uint64_t) (uint16_t) _mm_movemask_epi8(ws) << shift;
+        masks->op |= (uint64_t) (uint16_t) _mm_movemask_epi8(op) << shift;
+        masks->quote |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) << shift;
+    }
+}
+
+TARGET_AVX2 void classifyBlockAVX2(const char *block, BlockMasks *masks)
+{
+    memset(masks, 0, sizeof(BlockMasks));
+
+    for (int i = 0; i < 2; i++)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (block + i * 32));
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+
+        int shift = i * 32;
+        masks->whitespace |= (uint64_t) (uint32_t) _mm256_movemask_epi8(ws) << shift;
+        masks->op |= (uint64_t) (uint32_t) _mm256_movemask_epi8(op) << shift;
+        masks->quote |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))) << shift;
+        masks->backslash |= (uint64_t) (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))) << shift;
+    }
+}
+
+bool cpuHasAVX2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+
+    // The OS must also save the YMM registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+ClassifyBlockFunc getClassifyBlock()
+{
+    // NOTE(vincent): racing threads all compute the same value, no need to lock
+    static ClassifyBlockFunc classify = NULL;
+
+    if (!classify)
+    {
+#if defined(JSON_SIMD_X64)
+        classify = cpuHasAVX2() ? classifyBlockAVX2 : classifyBlockSSE2;
+#else
+        classify = classifyBlockScalar;
+#endif
+    }
+
+    return classify;
+}
+
+//
+// Bit manipulation helpers
+//
+
+int countTrailingZeros(uint64_t value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return (int) index;
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+// Each bit becomes the xor of itself and all the bits below it, which turns
+// the quote mask into an "inside a string" mask.
+uint64_t prefixXor(uint64_t value)
+{
+    value ^= value << 1;
+    value ^= value << 2;
+    value ^= value << 4;
+    value ^= value << 8;
+    value ^= value << 16;
+    value ^= value << 32;
+
+    return value;
+}
+
+// Returns the characters escaped by a backslash. Backslashes are rare so only
+// their positions are visited; carry is set when the last byte escapes the
+// first byte of the next block.
+uint64_t findEscaped(uint64_t backslash, uint64_t *carry)
+{
+    uint64_t escaped = 0;
+
+    if (*carry)
+    {
+        escaped = 1;
+        backslash &= ~1ULL;
+        *carry = 0;
+    }
+
+    while (backslash)
+    {
+        int i = countTrailingZeros(backslash);
+        backslash &= backslash - 1;
+
+        if (i == 63)
+        {
+            *carry = 1;
+            break;
+        }
+
+        uint64_t next = 1ULL << (i + 1);
+        escaped |= next;
+        backslash &= ~next;
+    }
+
+    return escaped;
+}
+
+//
+// StructuralIndex API
+//
+
+void freeStructuralIndex(StructuralIndex *index)
+{
+    const JSONAllocator *allocator = index->allocator;
+
+    freeMemory(allocator, index->positions);
+    memset(index, 0, sizeof(StructuralIndex));
+    index->allocator = allocator;
+}
+
+JSONError growStructuralIndex(StructuralIndex *index, size_t minimumCapacity)
+{
+    size_t newCapacity = index->capacity ? index->capacity : 1024;
+    while (newCapacity < minimumCapacity)
+    {
+        newCapacity *= 2;
+    }
+
+    uint32_t *positions = (uint32_t *) reallocMemory(index->allocator, index->positions, sizeof(uint32_t) * newCapacity);
+    if (!positions)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    index->positions = positions;
+    index->capacity = newCapacity;
+
+    return ERR_NOERROR;
+}
+
+JSONError buildStructuralIndex(StructuralIndex *index, const char *input, size_t inputLength)
+{
+    JSONError error;
+    ClassifyBlockFunc classify = getClassifyBlock();
+
+    uint64_t escapeCarry = 0;
+    uint64_t prevInString = 0;
+    uint64_t prevNonquoteScalar = 0;
+
+    index->count = 0;
+
+    for (size_t offset = 0; offset < inputLength; offset += 64)
+    {
+        // a block adds at most 64 positions, plus room for the sentinel
+        if (index->count + 65 > index->capacity)
+        {
+            if ((error = growStructuralIndex(index, index->count + 65)) != ERR_NOERROR)
+            {
+                return error;
+            }
+        }
+
+        const char *block = input + offset;
+
+        // The last block is padded with whitespace, which is never structural
+        char padded[64];
+        if (inputLength - offset < 64)
+        {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, block, inputLength - offset);
+            block = padded;
+        }
+
+        BlockMasks masks;
+        classify(block, &masks);
+
+        uint64_t escaped = findEscaped(masks.backslash, &escapeCarry);
+        uint64_t quote = masks.quote & ~escaped;
+
+        // includes the opening quote, excludes the closing one
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString = (uint64_t) ((int64_t) inString >> 63);
+
+        // A scalar starts on any non whitespace, non operator character which
+        // does not follow another one; quotes always start a string.
+        uint64_t scalar = ~(masks.op | masks.whitespace);
+        uint64_t nonquoteScalar = scalar & ~quote;
+        uint64_t followsNonquoteScalar = (nonquoteScalar << 1) | prevNonquoteScalar;
+        prevNonquoteScalar = nonquoteScalar >> 63;
+
+        uint64_t stringTail = inString ^ quote;
+        uint64_t structurals = (masks.op | (scalar & ~followsNonquoteScalar)) & ~stringTail;
+
+        uint32_t *positions = index->positions + index->count;
+        while (structurals)
+        {
+            *positions++ = (uint32_t) (offset + countTrailingZeros(structurals));
+            structurals &= structurals - 1;
+        }
+        index->count = (size_t) (positions - index->positions);
+    }
+
+    if (index->count + 1 > index->capacity)
+    {
+        if ((error = growStructuralIndex(index, index->count + 1)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+    index->positions[index->count] = (uint32_t) inputLength;
+
+    if (prevInString)
+    {
+        return ERR_INVALID_STRING;
+    }
+
+    return ERR_NOERROR;
+}
+
+//
+// Array splitting
+//
+
+JSONError findArraySplits(const char *input, size_t inputLength, size_t splitCount,
+                          size_t *splits, size_t *foundSplits, size_t *closing)
+{
+    ClassifyBlockFunc classify = getClassifyBlock();
+
+    uint64_t escapeCarry = 0;
+    uint64_t prevInString = 0;
+    size_t depth = 0;
+    size_t found = 0;
+    size_t nextTarget = inputLength / (splitCount + 1);
+
+    for (size_t offset = 0; offset < inputLength; offset += 64)
+    {
+        const char *block = input + offset;
+
+        char padded[64];
+        if (inputLength - offset < 64)
+        {
+            memset(padded, ' ', sizeof(padded));
+            memcpy(padded, block, inputLength - offset);
+            block = padded;
+        }
+
+        BlockMasks masks;
+        classify(block, &masks);
+
+        uint64_t escaped = findEscaped(masks.backslash, &escapeCarry);
+        uint64_t quote = masks.quote & ~escaped;
+        uint64_t inString = prefixXor(quote) ^ prevInString;
+        prevInString = (uint64_t) ((int64_t) inString >> 63);
+
+        // Only brackets and commas matter, colons are skipped right away
+        uint64_t op = masks.op & ~inString;
+        while (op)
+        {
+            int i = countTrailingZeros(op);
+            op &= op - 1;
+
+            switch (block[i])
+            {
+                case '{':
+                case '[':
+                {
+                    depth++;
+                    break;
+                }
+                case '}':
+                case ']':
+                {
+                    if (depth == 0)
+                    {
+                        return ERR_INVALID_ARRAY_SYNTAX;
+                    }
+
+                    if (--depth == 0)
+                    {
+                        if (block[i] != ']')
+                        {
+                            return ERR_INVALID_ARRAY_SYNTAX;
+                        }
+
+                        *foundSplits = found;
+                        *closing = offset + i;
+                        return ERR_NOERROR;
+                    }
+
+                    break;
+                }
+                case ',':
+                {
+                    if (depth == 1 && offset + i >= nextTarget && found < splitCount)
+                    {
+                        splits[found++] = offset + i;
+                        nextTarget = (inputLength / (splitCount + 1)) * (found + 1);
+                    }
+
+                    break;
+                }
+            }
+        }
+    }
+
+    return ERR_EOF;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "json.h"
+
+// Positions of the structural characters of a document: {}[]:, outside of
+// strings, plus the first character of every string and scalar. The array is
+// terminated by a sentinel equal to the input length (not part of count).
+struct StructuralIndex
+{
+    uint32_t *positions;
+    size_t count;
+    size_t capacity;
+
+    const JSONAllocator *allocator;
+};
+
+void freeStructuralIndex(StructuralIndex *index);
+
+// Classifies the input 64 bytes at a time with AVX2 or SSE2 when the CPU
+// supports it, with a scalar fallback. The input must be smaller than 4 GiB.
+JSONError buildStructuralIndex(StructuralIndex *index, const char *input, size_t inputLength);
+
+// Picks up to splitCount commas separating the elements of the array opening
+// input, each the first one after an evenly spaced offset, so the elements can
+// be parsed in about equal parts. closing is set to the bracket closing the
+// array, a '}' there is ERR_INVALID_ARRAY_SYNTAX. Other mismatched brackets
+// are only counted, the parsers of the parts reject them. Uses the same block
+// classification as buildStructuralIndex.
+JSONError findArraySplits(const char *input, size_t inputLength, size_t splitCount,
+                          size_t *splits, size_t *foundSplits, size_t *closing);
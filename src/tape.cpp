@@ -0,0 +1,101 @@
+#include "tape.h"
+#include "allocator.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Tape private API
+//
+
+void freeTape(Tape *tape)
+{
+    const JSONAllocator *allocator = tape->allocator;
+
+    freeMemory(allocator, tape->words);
+    memset(tape, 0, sizeof(Tape));
+    tape->allocator = allocator;
+}
+
+JSONError growTape(Tape *tape, size_t minimumCapacity)
+{
+    size_t newCapacity = tape->capacity ? tape->capacity * 2 : 1024;
+    while (newCapacity < minimumCapacity)
+    {
+        newCapacity *= 2;
+    }
+
+    uint64_t *words = (uint64_t *) reallocMemory(tape->allocator, tape->words, sizeof(uint64_t) * newCapacity);
+    if (!words)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    tape->words = words;
+    tape->capacity = newCapacity;
+
+    return ERR_NOERROR;
+}
+
+JSONNodeType getTapeNodeType(const uint64_t *word)
+{
+    switch (getTapeTag(*word))
+    {
+        case TAPE_OBJECT_START: return OBJECT_NODE;
+        case TAPE_ARRAY_START:  return ARRAY_NODE;
+        case TAPE_STRING:
+        case TAPE_STRING_VIEW:  return STRING_NODE;
+        case TAPE_INTEGER:      return INTEGER_NODE;
+        case TAPE_DOUBLE:       return DOUBLE_NODE;
+        case TAPE_TRUE:
+        case TAPE_FALSE:        return BOOLEAN_NODE;
+        case TAPE_NULL:         return NULL_NODE;
+        default:
+            return UNKNOWN;
+    }
+}
+
+const uint64_t* skipTapeValue(const uint64_t *word)
+{
+    switch (getTapeTag(*word))
+    {
+        case TAPE_OBJECT_START:
+        case TAPE_ARRAY_START:
+        {
+            return word + getTapePayload(*word);
+        }
+        case TAPE_STRING:
+        {
+            return word + 1 + (getTapePayload(*word) + 8) / 8;
+        }
+        case TAPE_STRING_VIEW:
+        case TAPE_INTEGER:
+        case TAPE_DOUBLE:
+        {
+            return word + 2;
+        }
+        default:
+        {
+            return word + 1;
+        }
+    }
+}
+
+const uint64_t* findTapeKey(const uint64_t *word, const char *key, size_t keyLength)
+{
+    // NOTE(vincent): no hash table on the tape, keys are compared in order
+    // with the length first, which rules out most of them.
+    for (word++; getTapeTag(*word) != TAPE_OBJECT_END;)
+    {
+        const uint64_t *value = skipTapeValue(word);
+
+        if (getTapePayload(*word) == keyLength && memcmp(getTapeStringData(word), key, keyLength) == 0)
+        {
+            return value;
+        }
+
+        word = skipTapeValue(value);
+    }
+
+    return NULL;
+}
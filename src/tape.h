@@ -0,0 +1,274 @@
+#pragma once
+
+#include <string.h>
+
+#include "json_private.h"
+#include "json.h"
+
+// JSON_PARSE_TAPE documents are a single array of 64-bit words, in document
+// order. The high byte of a word is a tag, the low 56 bits its payload:
+//
+//   { [       distance to the word after the matching close
+//   } ]       distance back to the matching open
+//   "         length, the NUL terminated data follows in the next words
+//   '         length of a view string, the next word points in the input
+//   l d       the next word holds the int64_t or the double bits
+//   t f n     true, false and null
+//
+// Keys are strings and precede their value. Nodes and strings handed out by
+// the public API point at their word with the lowest bit set, which tells
+// them apart from JSONNode and JSONString structs.
+
+enum TapeTag
+{
+    TAPE_OBJECT_START = '{',
+    TAPE_OBJECT_END = '}',
+    TAPE_ARRAY_START = '[',
+    TAPE_ARRAY_END = ']',
+    TAPE_STRING = '"',
+    TAPE_STRING_VIEW = '\'',
+    TAPE_INTEGER = 'l',
+    TAPE_DOUBLE = 'd',
+    TAPE_TRUE = 't',
+    TAPE_FALSE = 'f',
+    TAPE_NULL = 'n'
+};
+
+#define TAPE_PAYLOAD_MASK ((1ULL << 56) - 1)
+
+struct TapeBuilder
+{
+    Tape *tape;
+    uint32_t flags;
+
+    // Index + 1 of the innermost open container, 0 outside of the root. While
+    // a container is open its payload links to its parent the same way.
+    size_t open;
+};
+
+void freeTape(Tape *tape);
+JSONError growTape(Tape *tape, size_t minimumCapacity);
+
+JSONNodeType getTapeNodeType(const uint64_t *word);
+
+// Returns the word after the value starting at word
+const uint64_t* skipTapeValue(const uint64_t *word);
+
+// Returns the value of key in the object starting at word, NULL if missing
+const uint64_t* findTapeKey(const uint64_t *word, const char *key, size_t keyLength);
+
+inline bool isTapePointer(const void *ptr)
+{
+    return ((uintptr_t) ptr & 1) != 0;
+}
+
+inline const uint64_t* getTapeWord(const void *ptr)
+{
+    return (const uint64_t *) ((uintptr_t) ptr & ~(uintptr_t) 1);
+}
+
+inline JSONNode* makeTapeNode(const uint64_t *word)
+{
+    return (JSONNode *) ((uintptr_t) word | 1);
+}
+
+inline JSONString* makeTapeString(const uint64_t *word)
+{
+    return (JSONString *) ((uintptr_t) word | 1);
+}
+
+inline TapeTag getTapeTag(uint64_t word)
+{
+    return (TapeTag) (word >> 56);
+}
+
+inline uint64_t getTapePayload(uint64_t word)
+{
+    return word & TAPE_PAYLOAD_MASK;
+}
+
+inline char* getTapeStringData(const uint64_t *word)
+{
+    if (getTapeTag(*word) == TAPE_STRING_VIEW)
+    {
+        return (char *) (uintptr_t) word[1];
+    }
+
+    return (char *) (word + 1);
+}
+
+inline uint64_t makeTapeWord(TapeTag tag, uint64_t payload)
+{
+    return ((uint64_t) tag << 56) | payload;
+}
+
+//
+// TapeBuilder events
+//
+
+inline JSONError appendTapeWords(TapeBuilder *builder, size_t count, uint64_t **words)
+{
+    JSONError error;
+    Tape *tape = builder->tape;
+
+    if (tape->length + count > tape->capacity)
+    {
+        if ((error = growTape(tape, tape->length + count)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    *words = tape->words + tape->length;
+    tape->length += count;
+
+    return ERR_NOERROR;
+}
+
+inline JSONError appendTapeString(TapeBuilder *builder, const char *data, size_t length, bool inInput)
+{
+    JSONError error;
+    uint64_t *words;
+
+    if (inInput && (builder->flags & JSON_PARSE_VIEW_STRINGS))
+    {
+        if ((error = appendTapeWords(builder, 2, &words)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        words[0] = makeTapeWord(TAPE_STRING_VIEW, length);
+        words[1] = (uint64_t) (uintptr_t) data;
+
+        return ERR_NOERROR;
+    }
+
+    // Room for the NUL, the last word is cleared so the padding is too
+    size_t dataWords = (length + 8) / 8;
+    if ((error = appendTapeWords(builder, 1 + dataWords, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(TAPE_STRING, length);
+    words[dataWords] = 0;
+    memcpy(words + 1, data, length);
+
+    return ERR_NOERROR;
+}
+
+inline JSONError emitStartContainer(TapeBuilder *builder, JSONNodeType type)
+{
+    JSONError error;
+    uint64_t *words;
+
+    if ((error = appendTapeWords(builder, 1, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(type == OBJECT_NODE ? TAPE_OBJECT_START : TAPE_ARRAY_START, builder->open);
+    builder->open = builder->tape->length;
+
+    return ERR_NOERROR;
+}
+
+inline JSONError emitEndContainer(TapeBuilder *builder, JSONNodeType type)
+{
+    JSONError error;
+    uint64_t *words;
+    size_t open = builder->open - 1;
+    size_t close = builder->tape->length;
+
+    if ((error = appendTapeWords(builder, 1, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(type == OBJECT_NODE ? TAPE_OBJECT_END : TAPE_ARRAY_END, close - open);
+
+    // Distances keep the words valid wherever the tape ends up in memory
+    uint64_t *openWord = &builder->tape->words[open];
+    builder->open = (size_t) (*openWord & TAPE_PAYLOAD_MASK);
+    *openWord = makeTapeWord(getTapeTag(*openWord), close + 1 - open);
+
+    return ERR_NOERROR;
+}
+
+// NOTE(vincent): never called, JSON_PARSE_TAPE clears JSON_PARSE_LAZY
+inline JSONError emitLazyContainer(TapeBuilder *builder, const char *begin, size_t length)
+{
+    return ERR_INVALID_ARGUMENT;
+}
+
+inline JSONError emitKey(TapeBuilder *builder, const char *data, size_t length, bool inInput)
+{
+    return appendTapeString(builder, data, length, inInput);
+}
+
+inline JSONError emitString(TapeBuilder *builder, const char *data, size_t length, bool inInput)
+{
+    return appendTapeString(builder, data, length, inInput);
+}
+
+inline JSONError emitInteger(TapeBuilder *builder, int64_t value)
+{
+    JSONError error;
+    uint64_t *words;
+
+    if ((error = appendTapeWords(builder, 2, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(TAPE_INTEGER, 0);
+    memcpy(&words[1], &value, sizeof(value));
+
+    return ERR_NOERROR;
+}
+
+inline JSONError emitDouble(TapeBuilder *builder, double value)
+{
+    JSONError error;
+    uint64_t *words;
+
+    if ((error = appendTapeWords(builder, 2, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(TAPE_DOUBLE, 0);
+    memcpy(&words[1], &value, sizeof(value));
+
+    return ERR_NOERROR;
+}
+
+inline JSONError emitBoolean(TapeBuilder *builder, bool value)
+{
+    JSONError error;
+    uint64_t *words;
+
+    if ((error = appendTapeWords(builder, 1, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(value ? TAPE_TRUE : TAPE_FALSE, 0);
+
+    return ERR_NOERROR;
+}
+
+inline JSONError emitNull(TapeBuilder *builder)
+{
+    JSONError error;
+    uint64_t *words;
+
+    if ((error = appendTapeWords(builder, 1, &words)) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    words[0] = makeTapeWord(TAPE_NULL, 0);
+
+    return ERR_NOERROR;
+}
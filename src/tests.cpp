@@ -0,0 +1,334 @@
+#include "json.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Checks the promises of the library that parsing valid documents does not
+// exercise, such as giving the same result whichever path a parse takes.
+//
+//   tests
+//
+// Prints the checks which failed, exits with 1 if there is any.
+
+int failureCount = 0;
+
+#define CHECK(condition) checkCondition((condition), #condition, __FILE__, __LINE__)
+
+void checkCondition(bool condition, const char *text, const char *file, int line)
+{
+    if (!condition)
+    {
+        printf("%s:%d: check failed: %s\n", file, line, text);
+        failureCount++;
+    }
+}
+
+// Counts what the library asks for, the test fails if a block is left
+struct CountingAllocator
+{
+    size_t allocations;
+    size_t liveBlocks;
+};
+
+void* countingAlloc(void *userData, size_t size)
+{
+    CountingAllocator *counter = (CountingAllocator *) userData;
+
+    void *ptr = malloc(size);
+    if (ptr)
+    {
+        counter->allocations++;
+        counter->liveBlocks++;
+    }
+
+    return ptr;
+}
+
+void* countingRealloc(void *userData, void *ptr, size_t size)
+{
+    CountingAllocator *counter = (CountingAllocator *) userData;
+
+    void *newPtr = realloc(ptr, size);
+    if (newPtr)
+    {
+        counter->allocations++;
+        counter->liveBlocks += ptr ? 0 : 1;
+    }
+
+    return newPtr;
+}
+
+void countingFree(void *userData, void *ptr)
+{
+    CountingAllocator *counter = (CountingAllocator *) userData;
+
+    if (ptr)
+    {
+        counter->liveBlocks--;
+        free(ptr);
+    }
+}
+
+//
+// Input building
+//
+
+struct TestText
+{
+    char *data;
+    size_t length;
+    size_t capacity;
+};
+
+void appendTestText(TestText *text, const char *data, size_t length)
+{
+    if (text->length + length + 1 > text->capacity)
+    {
+        size_t newCapacity = text->capacity ? text->capacity * 2 : 4096;
+        while (newCapacity < text->length + length + 1)
+        {
+            newCapacity *= 2;
+        }
+
+        text->data = (char *) realloc(text->data, newCapacity);
+        if (!text->data)
+        {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+
+        text->capacity = newCapacity;
+    }
+
+    memcpy(text->data + text->length, data, length);
+    text->length += length;
+    text->data[text->length] = '\0';
+}
+
+void appendTestString(TestText *text, const char *data)
+{
+    appendTestText(text, data, strlen(data));
+}
+
+// Enough numbers for a root array to be parsed in parts with
+// JSON_PARSE_PARALLEL, each followed by a comma
+void appendManyElements(TestText *text)
+{
+    char number[32];
+
+    for (int i = 0; i < 200000; i++)
+    {
+        int length = sprintf(number, "%d,", i);
+        appendTestText(text, number, (size_t) length);
+    }
+}
+
+//
+// Parallel arrays
+//
+
+// Parses the input on one thread and on four, both must give the same error
+// and, without one, the same tree
+void checkSameParallelResult(const char *name, const char *input, size_t inputLength, JSONError expected)
+{
+    JSONDocument *sequential = JSONCreateDocument();
+    JSONDocument *parallel = JSONCreateDocument();
+
+    JSONParseOptions options = {};
+    JSONError sequentialError = JSONParseDocument(sequential, input, inputLength, &options);
+
+    options.flags = JSON_PARSE_PARALLEL;
+    options.threadCount = 4;
+    JSONError parallelError = JSONParseDocument(parallel, input, inputLength, &options);
+
+    if (sequentialError != expected || parallelError != expected)
+    {
+        printf("%s: expected error %d, sequential %d, parallel %d\n", name, expected, sequentialError,
+               parallelError);
+        failureCount++;
+    }
+    else if (expected == ERR_NOERROR)
+    {
+        char *sequentialOutput, *parallelOutput;
+        size_t sequentialLength, parallelLength;
+
+        CHECK(JSONSerialize(JSONDocumentGetRoot(sequential), 0, &sequentialOutput, &sequentialLength) == ERR_NOERROR);
+        CHECK(JSONSerialize(JSONDocumentGetRoot(parallel), 0, &parallelOutput, &parallelLength) == ERR_NOERROR);
+        CHECK(sequentialLength == parallelLength && memcmp(sequentialOutput, parallelOutput, sequentialLength) == 0);
+
+        JSONFreeSerialized(sequentialOutput);
+        JSONFreeSerialized(parallelOutput);
+    }
+
+    JSONFreeDocument(sequential);
+    JSONFreeDocument(parallel);
+}
+
+void testParallelArrays()
+{
+    struct MalformedCase
+    {
+        const char *name;
+        const char *prefix; // after the opening bracket, before the elements
+        const char *suffix; // after the comma of the last element
+        JSONError expected;
+    };
+
+    static const MalformedCase cases[] = {
+        { "well formed", "", "0]", ERR_NOERROR },
+        { "trailing whitespace", "", "0] \n", ERR_NOERROR },
+        { "trailing comma", "", "]", ERR_NOERROR },
+        { "mismatched close", "", "0}", ERR_INVALID_ARRAY_SYNTAX },
+        { "mismatched close after a comma", "", "}", ERR_INVALID_ARRAY_SYNTAX },
+        { "two trailing commas", "", ",]", ERR_INVALID_ARRAY_SYNTAX },
+        { "empty first element", ",", "0]", ERR_INVALID_ARRAY_SYNTAX },
+        { "bad last element", "", "nul]", ERR_INVALID_NULL_SYNTAX },
+        { "bad element before a bad close", "tru,", "0}", ERR_INVALID_BOOLEAN_SYNTAX },
+        { "mismatched nested close", "", "[0}]", ERR_INVALID_ARRAY_SYNTAX },
+        { "junk after the root", "", "0] x", ERR_INVALID_TREE_SYNTAX },
+        { "unterminated", "", "0", ERR_EOF },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        TestText input = {};
+        appendTestString(&input, "[");
+        appendTestString(&input, cases[i].prefix);
+        appendManyElements(&input);
+        appendTestString(&input, cases[i].suffix);
+
+        checkSameParallelResult(cases[i].name, input.data, input.length, cases[i].expected);
+
+        free(input.data);
+    }
+
+    // Four big strings: the parts are split at every comma, the last part is
+    // empty after the trailing one
+    TestText input = {};
+    appendTestString(&input, "[");
+    for (int i = 0; i < 3; i++)
+    {
+        appendTestString(&input, "\"");
+        for (int j = 0; j < 400000; j++)
+        {
+            appendTestString(&input, "a");
+        }
+        appendTestString(&input, "\",");
+    }
+
+    size_t lastComma = input.length - 1;
+    appendTestString(&input, "]");
+    checkSameParallelResult("trailing comma alone in the last part", input.data, input.length, ERR_NOERROR);
+
+    input.data[lastComma] = ' ';
+    input.data[input.length - 1] = '}';
+    checkSameParallelResult("mismatched close of big elements", input.data, input.length,
+                            ERR_INVALID_ARRAY_SYNTAX);
+
+    free(input.data);
+}
+
+//
+// Allocations
+//
+
+// Objects with the same keys and values of every type, some strings escaped
+void appendRecords(TestText *text)
+{
+    char record[160];
+
+    appendTestString(text, "[");
+    for (int i = 0; i < 2000; i++)
+    {
+        int length = sprintf(record, "%s{\"id\": %d, \"price\": %d.25, \"name\": \"item \\\"%d\\\"\", "
+                             "\"tags\": [\"a\", \"b\"], \"ok\": %s, \"next\": null}",
+                             i ? ",\n" : "", i, i, i, i % 2 ? "true" : "false");
+        appendTestText(text, record, (size_t) length);
+    }
+    appendTestString(text, "]");
+}
+
+JSONError feedInChunks(JSONParser *parser, const char *input, size_t inputLength)
+{
+    JSONError error;
+
+    JSONParserReset(parser);
+
+    // Small enough for tokens to be split between chunks
+    for (size_t offset = 0; offset < inputLength; offset += 1000)
+    {
+        size_t length = inputLength - offset < 1000 ? inputLength - offset : 1000;
+        if ((error = JSONParserFeed(parser, input + offset, length)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    return JSONParserFinish(parser);
+}
+
+// A document or parser parsing the same input again allocates nothing
+void testNoAllocationOnceWarm()
+{
+    TestText input = {};
+    appendRecords(&input);
+
+    const uint32_t flagSets[] = {
+        JSON_PARSE_DEFAULT, JSON_PARSE_VIEW_STRINGS, JSON_PARSE_LAZY | JSON_PARSE_STRUCTURAL_INDEX,
+        JSON_PARSE_TAPE
+    };
+
+    for (size_t i = 0; i < sizeof(flagSets) / sizeof(flagSets[0]); i++)
+    {
+        CountingAllocator counter = {};
+        JSONAllocator allocator = { countingAlloc, countingRealloc, countingFree, &counter };
+
+        JSONParseOptions options = {};
+        options.flags = flagSets[i];
+        options.allocator = &allocator;
+
+        // NULL options is what JSONParse does with the document of its node
+        JSONDocument *document = JSONCreateDocumentWithAllocator(&allocator);
+        CHECK(JSONParseDocument(document, input.data, input.length, NULL) == ERR_NOERROR);
+        size_t warm = counter.allocations;
+        CHECK(JSONParseDocument(document, input.data, input.length, NULL) == ERR_NOERROR);
+        CHECK(counter.allocations == warm);
+
+        CHECK(JSONParseDocument(document, input.data, input.length, &options) == ERR_NOERROR);
+        warm = counter.allocations;
+        CHECK(JSONParseDocument(document, input.data, input.length, &options) == ERR_NOERROR);
+        CHECK(counter.allocations == warm);
+
+        JSONDocument *parserDocument = JSONCreateDocumentWithAllocator(&allocator);
+        JSONParser *parser = JSONCreateParser(parserDocument, &options);
+        CHECK(feedInChunks(parser, input.data, input.length) == ERR_NOERROR);
+        warm = counter.allocations;
+        CHECK(feedInChunks(parser, input.data, input.length) == ERR_NOERROR);
+        CHECK(counter.allocations == warm);
+
+        JSONFreeParser(parser);
+        JSONFreeDocument(parserDocument);
+        JSONFreeDocument(document);
+
+        CHECK(counter.allocations > 0);
+        CHECK(counter.liveBlocks == 0);
+    }
+
+    free(input.data);
+}
+
+int main()
+{
+    testParallelArrays();
+    testNoAllocationOnceWarm();
+
+    if (failureCount)
+    {
+        printf("%d check(s) failed\n", failureCount);
+        return 1;
+    }
+
+    printf("all checks passed\n");
+    return 0;
+}
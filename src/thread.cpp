@@ -0,0 +1,162 @@
+#include "allocator.h"
+#include "thread.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+struct ThreadStart
+{
+    ThreadFunc func;
+    void *userData;
+};
+
+#if defined(_WIN32)
+
+typedef HANDLE ThreadHandle;
+
+DWORD WINAPI threadEntry(LPVOID param)
+{
+    ThreadStart *start = (ThreadStart *) param;
+    start->func(start->userData);
+
+    return 0;
+}
+
+bool startThread(ThreadHandle *thread, ThreadStart *start)
+{
+    *thread = CreateThread(NULL, 0, threadEntry, start, 0, NULL);
+
+    return *thread != NULL;
+}
+
+void joinThread(ThreadHandle thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+uint32_t getProcessorCount()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+
+    return info.dwNumberOfProcessors > 0 ? (uint32_t) info.dwNumberOfProcessors : 1;
+}
+
+size_t atomicFetchAdd(volatile size_t *value, size_t addend)
+{
+    return (size_t) InterlockedExchangeAdd64((volatile LONG64 *) value, (LONG64) addend);
+}
+
+size_t atomicLoad(volatile size_t *value)
+{
+    return (size_t) ReadNoFence64((volatile LONG64 *) value);
+}
+
+void* atomicLoadPointer(void *volatile *ptr)
+{
+    return ReadPointerAcquire(ptr);
+}
+
+bool atomicCompareExchangePointer(void *volatile *ptr, void *expected, void *desired)
+{
+    return InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+}
+
+#else
+
+typedef pthread_t ThreadHandle;
+
+void* threadEntry(void *param)
+{
+    ThreadStart *start = (ThreadStart *) param;
+    start->func(start->userData);
+
+    return NULL;
+}
+
+bool startThread(ThreadHandle *thread, ThreadStart *start)
+{
+    return pthread_create(thread, NULL, threadEntry, start) == 0;
+}
+
+void joinThread(ThreadHandle thread)
+{
+    pthread_join(thread, NULL);
+}
+
+uint32_t getProcessorCount()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (uint32_t) count : 1;
+}
+
+size_t atomicFetchAdd(volatile size_t *value, size_t addend)
+{
+    return __atomic_fetch_add(value, addend, __ATOMIC_RELAXED);
+}
+
+size_t atomicLoad(volatile size_t *value)
+{
+    return __atomic_load_n(value, __ATOMIC_RELAXED);
+}
+
+void* atomicLoadPointer(void *volatile *ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+bool atomicCompareExchangePointer(void *volatile *ptr, void *expected, void *desired)
+{
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#endif
+
+void runOnThreads(uint32_t threadCount, ThreadFunc func, void **userData, const JSONAllocator *allocator)
+{
+    ThreadHandle *threads = NULL;
+    ThreadStart *starts = NULL;
+    bool *started = NULL;
+
+    if (threadCount > 1)
+    {
+        threads = (ThreadHandle *) allocMemory(allocator, sizeof(ThreadHandle) * threadCount);
+        starts = (ThreadStart *) allocMemory(allocator, sizeof(ThreadStart) * threadCount);
+        started = (bool *) allocZeroedMemory(allocator, sizeof(bool) * threadCount);
+    }
+
+    // Without memory for the bookkeeping everything runs on this thread
+    if (threads && starts && started)
+    {
+        for (uint32_t i = 1; i < threadCount; i++)
+        {
+            starts[i].func = func;
+            starts[i].userData = userData[i];
+            started[i] = startThread(&threads[i], &starts[i]);
+        }
+    }
+
+    func(userData[0]);
+
+    if (threads && starts && started)
+    {
+        for (uint32_t i = 1; i < threadCount; i++)
+        {
+            if (started[i])
+            {
+                joinThread(threads[i]);
+            }
+        }
+    }
+
+    freeMemory(allocator, threads);
+    freeMemory(allocator, starts);
+    freeMemory(allocator, started);
+}
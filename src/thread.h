@@ -0,0 +1,24 @@
+#pragma once
+
+#include "json.h"
+
+typedef void (*ThreadFunc)(void *userData);
+
+// Runs func(userData[i]) on threadCount threads, the calling thread being the
+// first of them, and waits for all of them. Threads which cannot be started
+// are skipped, so the work must be shared through a counter rather than split
+// up front. The bookkeeping of the threads goes to allocator.
+void runOnThreads(uint32_t threadCount, ThreadFunc func, void **userData, const JSONAllocator *allocator);
+
+uint32_t getProcessorCount();
+
+// Returns the value before the addition
+size_t atomicFetchAdd(volatile size_t *value, size_t addend);
+// Reads a counter other threads add to, without ordering anything else
+size_t atomicLoad(volatile size_t *value);
+
+// Publishing a pointer: whatever was written to the memory it points to before
+// a successful exchange is visible to the threads loading it
+void* atomicLoadPointer(void *volatile *ptr);
+// Stores desired if ptr still holds expected, returns whether it did
+bool atomicCompareExchangePointer(void *volatile *ptr, void *expected, void *desired);
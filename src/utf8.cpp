@@ -0,0 +1,188 @@
+#include "utf8.h"
+
+#include <string.h>
+
+#if !defined(JSON_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define JSON_SIMD_X64
+#include <emmintrin.h>
+#endif
+
+//
+// UTF-8 private API
+//
+
+struct UTF8Lead
+{
+    uint8_t length; // 0 for bytes which cannot start a sequence
+    uint8_t secondMin;
+    uint8_t secondMax;
+};
+
+// Sequences started by the bytes 0xC0 to 0xFF. The range of the second byte
+// rules out overlong forms, surrogates and code points above U+10FFFF, the
+// other continuation bytes are always 0x80 to 0xBF (Unicode table 3-7).
+static const UTF8Lead utf8Leads[64] = {
+    { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // C0
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // C4
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // C8
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // CC
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // D0
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // D4
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // D8
+    { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF }, { 2, 0x80, 0xBF },  // DC
+    { 3, 0xA0, 0xBF }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF },  // E0
+    { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF },  // E4
+    { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF },  // E8
+    { 3, 0x80, 0xBF }, { 3, 0x80, 0x9F }, { 3, 0x80, 0xBF }, { 3, 0x80, 0xBF },  // EC
+    { 4, 0x90, 0xBF }, { 4, 0x80, 0xBF }, { 4, 0x80, 0xBF }, { 4, 0x80, 0xBF },  // F0
+    { 4, 0x80, 0x8F }, { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 },  // F4
+    { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 },  // F8
+    { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 }, { 0, 0x00, 0x00 },  // FC
+};
+
+static const int8_t hexDigitValues[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+     0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+// Returns the first byte of [ptr, end) which is not ASCII, or end
+const uint8_t* skipASCII(const uint8_t *ptr, const uint8_t *end)
+{
+#if defined(JSON_SIMD_X64)
+    for (; ptr + 32 <= end; ptr += 32)
+    {
+        __m128i first = _mm_loadu_si128((const __m128i *) ptr);
+        __m128i second = _mm_loadu_si128((const __m128i *) (ptr + 16));
+        if (_mm_movemask_epi8(_mm_or_si128(first, second)))
+        {
+            break;
+        }
+    }
+#endif
+
+    for (; ptr + 8 <= end; ptr += 8)
+    {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
+
+        if (word & 0x8080808080808080ULL)
+        {
+            break;
+        }
+    }
+
+    while (ptr < end && *ptr < 0x80)
+    {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+//
+// UTF-8 API
+//
+
+bool isValidUTF8(const char *data, size_t length)
+{
+    const uint8_t *ptr = (const uint8_t *) data;
+    const uint8_t *end = ptr + length;
+
+    for (;;)
+    {
+        ptr = skipASCII(ptr, end);
+        if (ptr == end)
+        {
+            return true;
+        }
+
+        if (*ptr < 0xC0)
+        {
+            return false;
+        }
+
+        const UTF8Lead *lead = &utf8Leads[*ptr - 0xC0];
+        if (lead->length == 0 || (size_t) (end - ptr) < lead->length)
+        {
+            return false;
+        }
+
+        if (ptr[1] < lead->secondMin || ptr[1] > lead->secondMax)
+        {
+            return false;
+        }
+
+        for (int i = 2; i < lead->length; i++)
+        {
+            if ((ptr[i] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+        }
+
+        ptr += lead->length;
+    }
+}
+
+size_t encodeUTF8(uint32_t codePoint, char *output)
+{
+    if (codePoint < 0x80)
+    {
+        output[0] = (char) codePoint;
+        return 1;
+    }
+
+    if (codePoint < 0x800)
+    {
+        output[0] = (char) (0xC0 | (codePoint >> 6));
+        output[1] = (char) (0x80 | (codePoint & 0x3F));
+        return 2;
+    }
+
+    if (codePoint < 0x10000)
+    {
+        output[0] = (char) (0xE0 | (codePoint >> 12));
+        output[1] = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+        output[2] = (char) (0x80 | (codePoint & 0x3F));
+        return 3;
+    }
+
+    output[0] = (char) (0xF0 | (codePoint >> 18));
+    output[1] = (char) (0x80 | ((codePoint >> 12) & 0x3F));
+    output[2] = (char) (0x80 | ((codePoint >> 6) & 0x3F));
+    output[3] = (char) (0x80 | (codePoint & 0x3F));
+    return 4;
+}
+
+bool decodeHex4(const char *input, uint32_t *value)
+{
+    int32_t digits[4];
+    for (int i = 0; i < 4; i++)
+    {
+        digits[i] = hexDigitValues[(uint8_t) input[i]];
+    }
+
+    // Any invalid digit is -1, which sets the sign bit of the or
+    if ((digits[0] | digits[1] | digits[2] | digits[3]) < 0)
+    {
+        return false;
+    }
+
+    *value = (uint32_t) ((digits[0] << 12) | (digits[1] << 8) | (digits[2] << 4) | digits[3]);
+
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "json.h"
+
+// Checks that data is well formed UTF-8: no overlong forms, surrogates, code
+// points above U+10FFFF or truncated sequences. ASCII runs are skipped with
+// SSE2 32 bytes at a time, 8 bytes at a time without it.
+bool isValidUTF8(const char *data, size_t length);
+
+// Writes the encoding of codePoint (at most 4 bytes), returns its length
+size_t encodeUTF8(uint32_t codePoint, char *output);
+
+// Decodes 4 hex digits of a \u escape with a lookup table, returns false if
+// one of them is not a hex digit
+bool decodeHex4(const char *input, uint32_t *value);
@@ -0,0 +1,370 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "buffer.h"
+#include "json_private.h"
+#include "number.h"
+#include "json.h"
+
+//
+// Writer private API
+//
+
+struct Writer
+{
+    Buffer *buffer;
+
+    // Output is handed to the callback whenever the buffer is full. Without
+    // callback everything accumulates in the buffer.
+    JSONWriteCallback callback;
+    void *userData;
+
+    uint32_t flags;
+};
+
+JSONError flushWriter(Writer *writer)
+{
+    if (!writer->callback || writer->buffer->index == 0)
+    {
+        return ERR_NOERROR;
+    }
+
+    JSONError error = writer->callback(writer->userData, writer->buffer->underlying, writer->buffer->index);
+    clearBuffer(writer->buffer);
+
+    return error;
+}
+
+JSONError writeBytes(Writer *writer, const char *data, size_t length)
+{
+    JSONError error;
+
+    if (writer->callback && writer->buffer->index + length >= writer->buffer->capacity)
+    {
+        if ((error = flushWriter(writer)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        // Too big to be worth buffering
+        if (length >= writer->buffer->capacity)
+        {
+            return writer->callback(writer->userData, data, length);
+        }
+    }
+
+    return putArrayToBuffer(writer->buffer, data, length);
+}
+
+JSONError writeChar(Writer *writer, char ch)
+{
+    return writeBytes(writer, &ch, 1);
+}
+
+JSONError writeNewline(Writer *writer, int depth)
+{
+    JSONError error;
+
+    if (!(writer->flags & JSON_WRITE_PRETTY))
+    {
+        return ERR_NOERROR;
+    }
+
+    if ((error = writeChar(writer, '\n')) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    for (int i = 0; i < depth; i++)
+    {
+        if ((error = writeBytes(writer, "    ", 4)) != ERR_NOERROR)
+        {
+            return error;
+        }
+    }
+
+    return ERR_NOERROR;
+}
+
+// Returns the first character in [ptr, end) which must be escaped: a quote, a
+// backslash or a control character. Checks 8 bytes at a time.
+const char* findCharToEscape(const char *ptr, const char *end)
+{
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highBits = 0x8080808080808080ULL;
+    const uint64_t quotes = ones * '"';
+    const uint64_t backslashes = ones * '\\';
+
+    for (; ptr + 8 <= end; ptr += 8)
+    {
+        uint64_t word;
+        memcpy(&word, ptr, sizeof(word));
+
+        uint64_t q = word ^ quotes;
+        uint64_t b = word ^ backslashes;
+        uint64_t control = (word - ones * 0x20) & ~word;
+        if ((((q - ones) & ~q) | ((b - ones) & ~b) | control) & highBits)
+        {
+            break;
+        }
+    }
+
+    for (; ptr < end; ptr++)
+    {
+        unsigned char ch = (unsigned char) *ptr;
+        if (ch < 0x20 || ch == '"' || ch == '\\')
+        {
+            return ptr;
+        }
+    }
+
+    return end;
+}
+
+JSONError writeString(Writer *writer, const char *data, size_t length)
+{
+    JSONError error;
+    const char *end = data + length;
+
+    if ((error = writeChar(writer, '"')) != ERR_NOERROR)
+    {
+        return error;
+    }
+
+    while (data < end)
+    {
+        // Copy everything up to the next character to escape in one go
+        const char *special = findCharToEscape(data, end);
+        if ((error = writeBytes(writer, data, (size_t) (special - data))) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        if (special == end)
+        {
+            break;
+        }
+
+        char escaped[6] = { '\\', 0, 0, 0, 0, 0 };
+        size_t escapedLength = 2;
+
+        switch (*special)
+        {
+            case '"':  escaped[1] = '"'; break;
+            case '\\': escaped[1] = '\\'; break;
+            case '\b': escaped[1] = 'b'; break;
+            case '\f': escaped[1] = 'f'; break;
+            case '\n': escaped[1] = 'n'; break;
+            case '\r': escaped[1] = 'r'; break;
+            case '\t': escaped[1] = 't'; break;
+            default:
+            {
+                const char *hex = "0123456789abcdef";
+                unsigned char ch = (unsigned char) *special;
+
+                escaped[1] = 'u';
+                escaped[2] = '0';
+                escaped[3] = '0';
+                escaped[4] = hex[ch >> 4];
+                escaped[5] = hex[ch & 0xF];
+                escapedLength = 6;
+                break;
+            }
+        }
+
+        if ((error = writeBytes(writer, escaped, escapedLength)) != ERR_NOERROR)
+        {
+            return error;
+        }
+
+        data = special + 1;
+    }
+
+    return writeChar(writer, '"');
+}
+
+JSONError writeNode(Writer *writer, JSONNode *node, int depth)
+{
+    JSONError error;
+    JSONNodeType type = JSONGetNodeType(node);
+
+    switch (type)
+    {
+        case OBJECT_NODE:
+        case ARRAY_NODE:
+        {
+            bool isObject = type == OBJECT_NODE;
+
+            if ((error = writeChar(writer, isObject ? '{' : '[')) != ERR_NOERROR)
+            {
+                return error;
+            }
+
+            JSONIterator iter;
+            initIterator(&iter, node);
+
+            JSONString *key;
+            JSONNode *value;
+            bool first = true;
+
+            while ((error = JSONIteratorGetNext(&iter, &key, &value)) == ERR_NOERROR)
+            {
+                if (!first && (error = writeChar(writer, ',')) != ERR_NOERROR)
+                {
+                    return error;
+                }
+                first = false;
+
+                if ((error = writeNewline(writer, depth + 1)) != ERR_NOERROR)
+                {
+                    return error;
+                }
+
+                if (isObject)
+                {
+                    if ((error = writeString(writer, JSONStringGetData(key), JSONStringGetLength(key))) != ERR_NOERROR)
+                    {
+                        return error;
+                    }
+
+                    bool pretty = (writer->flags & JSON_WRITE_PRETTY) != 0;
+                    if ((error = writeBytes(writer, ": ", pretty ? 2 : 1)) != ERR_NOERROR)
+                    {
+                        return error;
+                    }
+                }
+
+                if ((error = writeNode(writer, value, depth + 1)) != ERR_NOERROR)
+                {
+                    return error;
+                }
+            }
+
+            if (error != ERR_ITERATOR_NO_MORE_ELEMENTS)
+            {
+                return error;
+            }
+
+            // Empty containers stay on one line
+            if (!first && (error = writeNewline(writer, depth)) != ERR_NOERROR)
+            {
+                return error;
+            }
+
+            return writeChar(writer, isObject ? '}' : ']');
+        }
+        case STRING_NODE:
+        {
+            JSONString *string = JSONNodeGetString(node);
+
+            return writeString(writer, JSONStringGetData(string), JSONStringGetLength(string));
+        }
+        case INTEGER_NODE:
+        {
+            char buffer[32];
+            size_t length = formatInteger(JSONNodeGetInteger(node), buffer);
+
+            return writeBytes(writer, buffer, length);
+        }
+        case DOUBLE_NODE:
+        {
+            double value = JSONNodeGetDouble(node);
+
+            // Not representable in JSON
+            if (isnan(value) || isinf(value))
+            {
+                return writeBytes(writer, "null", 4);
+            }
+
+            char buffer[32];
+            size_t length = formatDouble(value, buffer);
+
+            return writeBytes(writer, buffer, length);
+        }
+        case BOOLEAN_NODE:
+        {
+            if (JSONNodeGetBool(node))
+            {
+                return writeBytes(writer, "true", 4);
+            }
+
+            return writeBytes(writer, "false", 5);
+        }
+        case NULL_NODE:
+        {
+            return writeBytes(writer, "null", 4);
+        }
+        default:
+        {
+            return ERR_INVALID_TREE_SYNTAX;
+        }
+    }
+}
+
+//
+// Writer public API
+//
+
+JSON_API JSONError JSONWrite(JSONNode *node, uint32_t flags, JSONWriteCallback callback, void *userData)
+{
+    JSONError error;
+
+    if (!callback)
+    {
+        return ERR_INVALID_ARGUMENT;
+    }
+
+    Writer writer = {};
+    writer.callback = callback;
+    writer.userData = userData;
+    writer.flags = flags;
+    writer.buffer = newBuffer(NULL);
+    if (!writer.buffer)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    if ((error = writeNode(&writer, node, 0)) == ERR_NOERROR)
+    {
+        error = flushWriter(&writer);
+    }
+
+    freeBuffer(writer.buffer);
+
+    return error;
+}
+
+JSON_API JSONError JSONSerialize(JSONNode *node, uint32_t flags, char **output, size_t *outputLength)
+{
+    JSONError error;
+
+    Writer writer = {};
+    writer.flags = flags;
+    writer.buffer = newBuffer(NULL);
+    if (!writer.buffer)
+    {
+        return ERR_OUT_OF_MEMORY;
+    }
+
+    if ((error = writeNode(&writer, node, 0)) != ERR_NOERROR
+            || (error = putCharToBuffer(writer.buffer, '\0')) != ERR_NOERROR)
+    {
+        freeBuffer(writer.buffer);
+        return error;
+    }
+
+    if (outputLength)
+    {
+        *outputLength = writer.buffer->index - 1;
+    }
+    *output = detachBufferData(writer.buffer);
+
+    return ERR_NOERROR;
+}
+
+JSON_API void JSONFreeSerialized(char *output)
+{
+    freeMemory(NULL, output);
+}